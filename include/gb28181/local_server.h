@@ -82,6 +82,14 @@ public:
      */
     virtual std::shared_ptr<SubordinatePlatform> add_subordinate_platform(subordinate_account &&account) = 0;
 
+    /**
+     * 批量添加下级平台, 适用于启动时加载大量平台; 平台对象在调用线程依次创建, 平台表按分片批量加入
+     * @param accounts
+     * @return 与 accounts 一一对应, 被同批次重复编码覆盖的位置为 nullptr
+     */
+    virtual std::vector<std::shared_ptr<SubordinatePlatform>>
+    add_subordinate_platforms(std::vector<subordinate_account> &&accounts) = 0;
+
     /**
      * 移除下级平台
      * @param platform_id
@@ -94,6 +102,13 @@ public:
      */
     virtual std::shared_ptr<SuperPlatform> add_super_platform(super_account &&account) = 0;
 
+    /**
+     * 批量添加上级平台并开始注册, 创建方式同 add_subordinate_platforms
+     * @param accounts
+     * @return 与 accounts 一一对应, 被同批次重复编码覆盖的位置为 nullptr
+     */
+    virtual std::vector<std::shared_ptr<SuperPlatform>> add_super_platforms(std::vector<super_account> &&accounts) = 0;
+
     /**
      * 移除上级平台
      * @param platform_id
@@ -107,6 +122,30 @@ public:
 
     virtual uint32_t make_ssrc(bool is_playback = false) = 0;
 
+    /**
+     * 获取服务运行统计
+     * @return
+     */
+    virtual server_statistics get_statistics() const = 0;
+
+    /**
+     * 开启或关闭 sip 报文抓包, 报文保存在固定大小的内存环形缓冲中
+     * @param enable
+     */
+    virtual void set_capture_enabled(bool enable) = 0;
+    /**
+     * 将抓包缓冲导出为 pcap 文件
+     * @param path 文件路径
+     * @return
+     */
+    virtual bool dump_capture(const std::string &path) = 0;
+    /**
+     * 收发报文中出现指定平台编码时, 自动导出一次抓包缓冲
+     * @param platform_id 平台编码, 为空时取消
+     * @param path 文件路径
+     */
+    virtual void set_capture_trigger(const std::string &platform_id, const std::string &path) = 0;
+
 protected:
     LocalServer() = default;
 };
@@ -88,7 +88,66 @@ struct sip_account {
 struct local_account : public sip_account {
     bool allow_auto_register { false }; // 是否允许自动注册
     TransportType transport_type { TransportType::both }; // 监听的网络
+    bool udp_reuse_port { false }; // udp 是否在每个 poller 上以 SO_REUSEPORT 绑定同一端口
+    uint32_t session_idle_timeout { 60 }; // sip 连接空闲超时时间(秒), 为 0 时不检测
+    uint32_t tcp_pool_standby { 300 }; // 出站 tcp 连接最后一次使用后保留与热备的时长(秒), 为 0 时不使用连接池
+    // 接收过载保护, 取值为 0 时不限制
+    uint32_t session_max_queued_bytes { 1024 * 1024 }; // 单个 tcp 连接缓存的最大字节数, 超出后暂停读取
+    uint32_t session_max_queued_messages { 256 }; // 单个 tcp 连接等待处理的最大消息数, 超出后暂停读取
+    uint64_t server_max_queued_bytes { 64 * 1024 * 1024 }; // 整个服务缓存的最大字节数
+    uint32_t server_max_queued_messages { 16384 }; // 整个服务等待处理的最大消息数
+    uint32_t overload_retry_after { 5 }; // 服务过载时 udp 请求回复 503 的 Retry-After(秒), 为 0 时直接丢弃
+    // 接收准入控制, 解析之前按来源地址与请求方法限速, 速率为 0 时不限制
+    uint32_t admission_register_rate { 0 }; // 单个来源每秒允许的 REGISTER 数
+    uint32_t admission_message_rate { 0 }; // 单个来源每秒允许的 MESSAGE 数
+    uint32_t admission_burst { 10 }; // 令牌桶容量
+    // 注册风暴控制, 限制每秒转为在线的下级平台数, 超出的注册回复 503 并通过 Retry-After 错开重试
+    uint32_t register_governor_rate { 0 }; // 每秒允许的新注册数, 为 0 时不限制
+    uint32_t register_governor_max_retry { 120 }; // Retry-After 上限(秒)
+    bool keepalive_event { true }; // 是否广播下级心跳事件 kEventSubKeepalive, 关闭且未设置心跳回调时心跳不再解析 xml
+    // 下级平台状态快照, 重启后恢复在线状态与联系地址
+    std::string snapshot_path; // 快照文件路径, 为空时不启用
+    uint32_t snapshot_interval { 10 }; // 快照写入间隔(秒)
+    // 平台 poller 亲和, 开启后每个平台按编码哈希固定在一个 poller 上, 定时器、请求、收到的 MESSAGE 与回调均在该线程执行,
+    // 平台内部的请求表与状态回调不再加锁
+    bool platform_poller_affinity { false };
+    // 上级平台调度, 所有上级平台的注册刷新与心跳由一个后台时间轮统一调度
+    uint32_t super_schedule_jitter { 10 }; // 注册刷新与心跳随机提前的最大比例(百分比), 为 0 时不抖动
+    uint32_t super_register_concurrency { 16 }; // 同时进行中的上级注册数上限, 为 0 时不限制
 };
+/**
+ * 服务运行统计
+ */
+struct server_statistics {
+    uint64_t parser_pool_hit { 0 }; // sip 解析器复用次数
+    uint64_t parser_pool_miss { 0 }; // sip 解析器新建次数
+    // 接收处理耗时为消息分帧完成到协议栈处理返回的累计时长, 除以消息数即为平均时延
+    uint64_t udp_recv_messages { 0 }; // udp 接收消息数
+    uint64_t udp_recv_cost_us { 0 }; // udp 接收处理累计耗时(微秒)
+    uint64_t tcp_recv_messages { 0 }; // tcp 接收消息数
+    uint64_t tcp_recv_cost_us { 0 }; // tcp 接收处理累计耗时(微秒)
+    // 发送合批直方图, 第 i 个桶统计取值在 [2^i, 2^(i+1)) 的次数, 最后一个桶包含更大的值
+    uint64_t egress_queue_depth[8] {}; // 每轮事件循环刷新时排队的消息数
+    uint64_t egress_flush_size[8] {}; // 单个 socket 每次刷新合并的消息数
+    uint64_t recv_queued_bytes { 0 }; // 当前等待处理的接收字节数
+    uint64_t recv_queued_messages { 0 }; // 当前等待处理的接收消息数
+    uint64_t overload_udp_dropped { 0 }; // 过载丢弃的 udp 消息数
+    uint64_t overload_udp_rejected { 0 }; // 过载回复 503 的 udp 请求数
+    uint64_t overload_tcp_paused { 0 }; // tcp 连接暂停读取的次数
+    uint64_t admission_rejected { 0 }; // 准入控制拒绝的请求数
+    uint64_t register_governor_admitted { 0 }; // 注册风暴控制接受的注册数
+    uint64_t register_governor_deferred { 0 }; // 注册风暴控制推迟(回复 503)的注册数
+    uint64_t register_governor_queue { 0 }; // 已推迟、预计尚未重试的注册数
+    uint64_t keepalive_watched { 0 }; // 心跳超时检测中的下级平台数
+    uint64_t keepalive_timeout { 0 }; // 因心跳超时下线的下级平台数
+    // 上级平台调度延迟为任务实际执行时间晚于(加入抖动后的)到期时间的时长, 累计值除以任务数即为平均延迟
+    uint64_t super_registering { 0 }; // 进行中的上级注册数
+    uint64_t super_register_waiting { 0 }; // 已到期、等待名额的上级注册数
+    uint64_t super_schedule_executed { 0 }; // 已执行的上级注册与心跳任务数
+    uint64_t super_schedule_slip_us { 0 }; // 累计调度延迟(微秒)
+    uint64_t super_schedule_slip_max_us { 0 }; // 最大调度延迟(微秒)
+};
+
 /**
  * 上下级连平台基本账户信息
  */
@@ -104,7 +163,7 @@ struct platform_account : public sip_account {
  * 下级平台账户信息
  */
 struct subordinate_account : public platform_account {
-
+    uint32_t keepalive_timeout { 90 }; // 心跳超时时间(秒), 超过该时间未收到注册或心跳则判定离线, 为 0 时不检测
 };
 /**
  * 上级平台账户信息
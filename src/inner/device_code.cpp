@@ -0,0 +1,113 @@
+#include <cstring>
+
+#include "device_code.h"
+
+namespace gb28181 {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define GB28181_DEVICE_CODE_SWAR 0
+#else
+#define GB28181_DEVICE_CODE_SWAR 1
+#endif
+
+#if GB28181_DEVICE_CODE_SWAR
+static inline uint64_t load_eight(const char *data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// 8 个字节均在 '0'~'9' 之间
+static inline bool is_eight_digits(uint64_t value) {
+    return ((value & 0xF0F0F0F0F0F0F0F0ull) | (((value + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+        == 0x3333333333333333ull;
+}
+
+// 8 位十进制转整数, 首字符在低字节
+static inline uint64_t parse_eight_digits(uint64_t value) {
+    value -= 0x3030303030303030ull;
+    value = value * 10 + (value >> 8);
+    value = (((value & 0x000000FF000000FFull) * (100 + (1000000ull << 32)))
+             + (((value >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))))
+        >> 32;
+    return static_cast<uint32_t>(value);
+}
+#else
+static inline bool parse_digits(const char *data, size_t size, uint64_t &value) {
+    value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        auto digit = static_cast<uint8_t>(data[i] - '0');
+        if (digit > 9) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    return true;
+}
+#endif
+
+bool DeviceCode::parse(const char *data, size_t size, DeviceCode &code) {
+    if (size != 20 || data == nullptr) {
+        return false;
+    }
+#if GB28181_DEVICE_CODE_SWAR
+    // [0,8) [8,16) [12,20) 三段覆盖全部 20 个字符, 最后一段与第二段重叠 4 个字符
+    auto first = load_eight(data);
+    auto second = load_eight(data + 8);
+    auto third = load_eight(data + 12);
+    if (!is_eight_digits(first) || !is_eight_digits(second) || !is_eight_digits(third)) {
+        return false;
+    }
+    auto a = parse_eight_digits(first);
+    auto b = parse_eight_digits(second);
+    auto c = parse_eight_digits(third);
+    code._high = a * 100 + b / 1000000;
+    code._low = (b / 10000 % 100) * 100000000 + c;
+    return true;
+#else
+    return parse_digits(data, 10, code._high) && parse_digits(data + 10, 10, code._low);
+#endif
+}
+
+std::string DeviceCode::str() const {
+    if (!valid()) {
+        return {};
+    }
+    std::string ret(20, '0');
+    auto high = _high;
+    auto low = _low;
+    for (int i = 9; i >= 0; --i) {
+        ret[i] = static_cast<char>('0' + high % 10);
+        ret[i + 10] = static_cast<char>('0' + low % 10);
+        high /= 10;
+        low /= 10;
+    }
+    return ret;
+}
+
+size_t DeviceCode::hash() const {
+    // splitmix64 混合, 序号连续的编码也能均匀分布到各个桶
+    uint64_t value = _high * 0x9E3779B97F4A7C15ull ^ _low;
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+    return static_cast<size_t>(value);
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   device_code.cpp
+创建时间:   26-10-17 下午9:10
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午9:10
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午9:10       描述:   创建文件
+
+**********************************************************************************************************/
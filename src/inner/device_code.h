@@ -0,0 +1,72 @@
+#ifndef gb28181_src_inner_DEVICE_CODE_H
+#define gb28181_src_inner_DEVICE_CODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace gb28181 {
+
+/**
+ * GB/T 28181 20 位设备/平台编码
+ * 编码结构: 中心编码(8) + 行业编码(2) + 类型编码(3) + 网络标识(1) + 序号(6);
+ * 20 位十进制超过 64 位整数范围, 按前后各 10 位拆成两个整数保存, 比较与哈希不再涉及字符串
+ */
+class DeviceCode {
+public:
+    DeviceCode() = default;
+
+    /**
+     * 校验并解析 20 位十进制编码, 小端平台每次处理 8 个字符
+     * @return 长度不为 20 或包含非数字字符时返回 false
+     */
+    static bool parse(const char *data, size_t size, DeviceCode &code);
+    static bool parse(const std::string &id, DeviceCode &code) { return parse(id.data(), id.size(), code); }
+
+    bool valid() const { return _high < kHalfLimit; }
+
+    /**
+     * 中心编码, 包含省、市、区县、基层单位
+     */
+    uint32_t centre() const { return static_cast<uint32_t>(_high / 100); }
+    uint32_t industry() const { return static_cast<uint32_t>(_high % 100); }
+    uint32_t type() const { return static_cast<uint32_t>(_low / 10000000); }
+    uint32_t network() const { return static_cast<uint32_t>(_low / 1000000 % 10); }
+    uint32_t serial() const { return static_cast<uint32_t>(_low % 1000000); }
+
+    std::string str() const;
+    size_t hash() const;
+
+    bool operator==(const DeviceCode &other) const { return _high == other._high && _low == other._low; }
+    bool operator!=(const DeviceCode &other) const { return !(*this == other); }
+    bool operator<(const DeviceCode &other) const {
+        return _high < other._high || (_high == other._high && _low < other._low);
+    }
+
+    struct Hash {
+        size_t operator()(const DeviceCode &code) const { return code.hash(); }
+    };
+
+private:
+    static constexpr uint64_t kHalfLimit = 10000000000ull;
+    uint64_t _high { kHalfLimit }; // 前 10 位
+    uint64_t _low { 0 }; // 后 10 位
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_DEVICE_CODE_H
+
+/**********************************************************************************************************
+文件名称:   device_code.h
+创建时间:   26-10-17 下午9:10
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午9:10
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午9:10       描述:   创建文件
+
+**********************************************************************************************************/
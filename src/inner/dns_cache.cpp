@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <Poller/Timer.h>
+#include <Thread/WorkThreadPool.h>
+#include <Util/util.h>
+
+#include "dns_cache.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+// 后台刷新检查间隔
+static constexpr float kTimerSecond = 1.0f;
+// 超过该时长未使用的域名不再后台刷新, 覆盖常见的注册刷新周期
+static constexpr uint64_t kIdleMS = 3600 * 1000;
+
+static void set_port(struct sockaddr_storage &addr, uint16_t port) {
+    if (addr.ss_family == AF_INET) {
+        reinterpret_cast<struct sockaddr_in *>(&addr)->sin_port = htons(port);
+    } else if (addr.ss_family == AF_INET6) {
+        reinterpret_cast<struct sockaddr_in6 *>(&addr)->sin6_port = htons(port);
+    }
+}
+
+DnsCache &DnsCache::Instance() {
+    static DnsCache instance;
+    return instance;
+}
+
+DnsCache::DnsCache()
+    : _positive_ttl_ms(300 * 1000)
+    , _negative_ttl_ms(10 * 1000) {
+    _resolver = [](const std::string &host, struct sockaddr_storage &addr) {
+        return SockUtil::getDomainIP(host.c_str(), 0, addr, AF_INET, SOCK_DGRAM, IPPROTO_TCP);
+    };
+}
+
+void DnsCache::set_resolver(Resolver resolver) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _resolver = std::move(resolver);
+    _entries.clear();
+}
+
+void DnsCache::set_ttl(uint32_t positive_ttl, uint32_t negative_ttl) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _positive_ttl_ms = positive_ttl * 1000ull;
+    _negative_ttl_ms = negative_ttl * 1000ull;
+}
+
+void DnsCache::clear() {
+    std::lock_guard<std::mutex> lck(_mtx);
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        // 正在解析的条目保留, 避免等待中的请求丢失
+        if (it->second.resolving) {
+            it->second.expire_time = 0;
+            ++it;
+        } else {
+            it = _entries.erase(it);
+        }
+    }
+}
+
+void DnsCache::resolve(const std::string &host, uint16_t port, Callback cb) {
+    if (SockUtil::is_ipv4(host.c_str()) || SockUtil::is_ipv6(host.c_str())) {
+        cb(true, SockUtil::make_sockaddr(host.c_str(), port));
+        return;
+    }
+    auto now = getCurrentMillisecond(true);
+    struct sockaddr_storage addr {};
+    bool success = false;
+    bool need_lookup = false;
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        if (!_timer) {
+            _timer = std::make_shared<Timer>(
+                kTimerSecond,
+                [this]() {
+                    on_timer();
+                    return true;
+                },
+                WorkThreadPool::Instance().getPoller());
+        }
+        auto &entry = _entries[host];
+        entry.use_time = now;
+        if (entry.expire_time <= now) {
+            // 已过期或从未解析, 等待解析结果
+            entry.pending.emplace_back(port, std::move(cb));
+            need_lookup = !entry.resolving;
+            entry.resolving = queued = true;
+        } else {
+            success = entry.success;
+            addr = entry.addr;
+            if (success && !entry.resolving && now >= entry.refresh_time) {
+                need_lookup = entry.resolving = true;
+            }
+        }
+    }
+    // 在锁外投递解析任务, 允许解析器同步完成
+    if (need_lookup) {
+        lookup(host);
+    }
+    if (!queued) {
+        set_port(addr, port);
+        cb(success, addr);
+    }
+}
+
+void DnsCache::on_timer() {
+    std::vector<std::string> hosts;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        auto now = getCurrentMillisecond(true);
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            auto &entry = it->second;
+            if (entry.resolving) {
+                ++it;
+                continue;
+            }
+            if (now >= entry.use_time + kIdleMS) {
+                // 长时间未使用, 不再刷新, 过期后删除
+                if (entry.expire_time <= now) {
+                    it = _entries.erase(it);
+                } else {
+                    ++it;
+                }
+                continue;
+            }
+            // 失败结果不主动重试, 等待下次使用
+            if (entry.success && now >= entry.refresh_time) {
+                entry.resolving = true;
+                hosts.emplace_back(it->first);
+            }
+            ++it;
+        }
+    }
+    for (auto &host : hosts) {
+        lookup(host);
+    }
+}
+
+void DnsCache::lookup(const std::string &host) {
+    Resolver resolver;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        resolver = _resolver;
+    }
+    WorkThreadPool::Instance().getExecutor()->async([this, host, resolver]() {
+        struct sockaddr_storage addr {};
+        auto success = resolver(host, addr);
+        if (!success) {
+            WarnL << "dns resolution failed: " << host;
+        }
+        std::vector<std::pair<uint16_t, Callback>> pending;
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            auto &entry = _entries[host];
+            auto now = getCurrentMillisecond(true);
+            entry.resolving = false;
+            if (success) {
+                entry.success = true;
+                entry.addr = addr;
+                entry.expire_time = now + _positive_ttl_ms;
+                // 使用超过 80% 的 ttl 后在后台刷新
+                entry.refresh_time = now + _positive_ttl_ms * 4 / 5;
+            } else if (entry.success) {
+                // 解析失败但有旧地址, 继续使用旧地址, 按失败 ttl 重试
+                entry.expire_time = (std::max)(entry.expire_time, now + _negative_ttl_ms);
+                entry.refresh_time = now + _negative_ttl_ms;
+            } else {
+                entry.expire_time = now + _negative_ttl_ms;
+                entry.refresh_time = entry.expire_time;
+            }
+            success = entry.success;
+            addr = entry.addr;
+            entry.pending.swap(pending);
+        }
+        for (auto &it : pending) {
+            auto result = addr;
+            set_port(result, it.first);
+            it.second(success, result);
+        }
+    });
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   dns_cache.cpp
+创建时间:   26-10-17 下午6:40
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午6:40
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午6:40       描述:   创建文件
+
+**********************************************************************************************************/
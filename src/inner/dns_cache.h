@@ -0,0 +1,90 @@
+#ifndef gb28181_src_inner_DNS_CACHE_H
+#define gb28181_src_inner_DNS_CACHE_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Network/sockutil.h"
+
+namespace toolkit {
+class Timer;
+}
+
+namespace gb28181 {
+
+/**
+ * 异步域名解析缓存
+ * 解析在 WorkThreadPool 中执行, 相同域名同时只解析一次, 其余请求等待同一结果;
+ * 成功与失败结果分别按 ttl 缓存, 成功结果接近过期时由后台定时器刷新, 长时间未使用的域名不再刷新, 过期后删除;
+ * 解析失败时若有旧地址则继续使用, 避免 dns 抖动影响业务
+ */
+class DnsCache {
+public:
+    using Resolver = std::function<bool(const std::string &host, struct sockaddr_storage &addr)>;
+    using Callback = std::function<void(bool success, const struct sockaddr_storage &addr)>;
+
+    static DnsCache &Instance();
+
+    /**
+     * 替换解析方法, 默认使用 SockUtil::getDomainIP, 可替换为本地桩解析器用于测试
+     */
+    void set_resolver(Resolver resolver);
+
+    /**
+     * 设置缓存时长
+     * @param positive_ttl 解析成功结果的缓存时长(秒)
+     * @param negative_ttl 解析失败结果的缓存时长(秒)
+     */
+    void set_ttl(uint32_t positive_ttl, uint32_t negative_ttl);
+
+    /**
+     * 解析域名, ip 地址与缓存命中时在当前线程直接回调, 否则在解析线程中回调
+     */
+    void resolve(const std::string &host, uint16_t port, Callback cb);
+
+    void clear();
+
+private:
+    DnsCache();
+    void lookup(const std::string &host);
+    void on_timer();
+
+private:
+    struct Entry {
+        struct sockaddr_storage addr {};
+        bool success { false };
+        bool resolving { false };
+        uint64_t refresh_time { 0 }; // 后台刷新时间(毫秒)
+        uint64_t expire_time { 0 }; // 过期时间(毫秒)
+        uint64_t use_time { 0 }; // 最后一次使用时间(毫秒)
+        std::vector<std::pair<uint16_t, Callback>> pending; // 等待解析结果的请求
+    };
+
+    std::mutex _mtx;
+    Resolver _resolver;
+    uint64_t _positive_ttl_ms;
+    uint64_t _negative_ttl_ms;
+    std::unordered_map<std::string, Entry> _entries;
+    std::shared_ptr<toolkit::Timer> _timer; // 后台刷新, 首次解析域名时启动
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_DNS_CACHE_H
+
+/**********************************************************************************************************
+文件名称:   dns_cache.h
+创建时间:   26-10-17 下午6:40
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午6:40
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午6:40       描述:   创建文件
+
+**********************************************************************************************************/
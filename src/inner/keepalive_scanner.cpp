@@ -0,0 +1,107 @@
+#include <cctype>
+
+#include "keepalive_scanner.h"
+
+namespace gb28181 {
+
+static std::string_view trim(std::string_view value) {
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+// 查找 <name>value</name>, 只在 [0, limit) 范围内查找
+static bool find_element(std::string_view xml, std::string_view name, size_t limit, std::string_view &value) {
+    size_t pos = 0;
+    while ((pos = xml.find(name, pos)) != std::string_view::npos && pos < limit) {
+        auto begin = pos + name.size();
+        // 必须是完整的开始标签 <name>
+        if (pos == 0 || xml[pos - 1] != '<' || begin >= xml.size() || xml[begin] != '>') {
+            pos = begin;
+            continue;
+        }
+        ++begin;
+        auto end = xml.find('<', begin);
+        if (end == std::string_view::npos || end + 2 + name.size() > xml.size() || xml[end + 1] != '/'
+            || xml.substr(end + 2, name.size()) != name) {
+            return false;
+        }
+        value = trim(xml.substr(begin, end - begin));
+        return true;
+    }
+    return false;
+}
+
+bool KeepaliveScanner::scan(const char *data, size_t size, Result &result) {
+    std::string_view xml(data, size);
+    result.declaration = {};
+    // 跳过 xml 声明与注释, 找到根元素
+    size_t pos = 0;
+    while ((pos = xml.find('<', pos)) != std::string_view::npos) {
+        if (pos + 1 < xml.size() && (xml[pos + 1] == '?' || xml[pos + 1] == '!')) {
+            auto end = xml.find('>', pos);
+            if (end == std::string_view::npos) {
+                return false;
+            }
+            if (xml[pos + 1] == '?' && result.declaration.empty()) {
+                result.declaration = xml.substr(pos + 2, end - pos - 2);
+            }
+            pos = end;
+            continue;
+        }
+        break;
+    }
+    if (pos == std::string_view::npos) {
+        return false;
+    }
+    static constexpr std::string_view kRoot = "<Notify>";
+    if (xml.substr(pos, kRoot.size()) != kRoot) {
+        return false;
+    }
+    auto body = xml.substr(pos + kRoot.size());
+    // Info 内同样包含 DeviceID, 只查找 Info 之前的部分
+    auto limit = body.find("<Info>");
+    if (limit == std::string_view::npos) {
+        limit = body.size();
+    }
+    std::string_view cmd_type;
+    if (!find_element(body, "CmdType", limit, cmd_type) || cmd_type != "Keepalive") {
+        return false;
+    }
+    if (!find_element(body, "DeviceID", limit, result.device_id) || result.device_id.empty()) {
+        return false;
+    }
+    // SN 按 int 解析, 超过 9 位的交给完整解析流程
+    if (!find_element(body, "SN", limit, result.sn) || result.sn.empty() || result.sn.size() > 9) {
+        return false;
+    }
+    for (auto ch : result.sn) {
+        if (!std::isdigit(static_cast<unsigned char>(ch))) {
+            return false;
+        }
+    }
+    if (!find_element(body, "Status", limit, result.status)) {
+        return false;
+    }
+    return true;
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   keepalive_scanner.cpp
+创建时间:   26-10-17 下午4:50
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午4:50
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午4:50       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,48 @@
+#ifndef gb28181_src_inner_KEEPALIVE_SCANNER_H
+#define gb28181_src_inner_KEEPALIVE_SCANNER_H
+
+#include <cstddef>
+#include <string_view>
+
+namespace gb28181 {
+
+/**
+ * 心跳消息快速识别
+ * 直接在报文字节上查找 Notify/Keepalive 及其字段, 不构建 xml DOM, 不申请内存;
+ * 字段均为 ascii, 与报文编码无关; 无法识别的格式返回 false, 由完整的 xml 解析流程处理
+ */
+class KeepaliveScanner {
+public:
+    struct Result {
+        std::string_view device_id;
+        std::string_view sn; // 1~9 位数字, 可以直接按 int 解析
+        std::string_view status;
+        std::string_view declaration; // xml 声明 <?...?> 的内容, 没有声明时为空, 用于识别字符集
+    };
+
+    /**
+     * @param data xml 负载
+     * @param size 负载长度
+     * @param result 字段指向 data 内部
+     * @return 是心跳消息且字段完整时返回 true
+     */
+    static bool scan(const char *data, size_t size, Result &result);
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_KEEPALIVE_SCANNER_H
+
+/**********************************************************************************************************
+文件名称:   keepalive_scanner.h
+创建时间:   26-10-17 下午4:50
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午4:50
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午4:50       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,222 @@
+#ifndef gb28181_src_inner_PLATFORM_REGISTRY_H
+#define gb28181_src_inner_PLATFORM_REGISTRY_H
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "device_code.h"
+
+namespace gb28181 {
+
+/**
+ * 按平台编码分片的平台表
+ * 编码哈希决定分片, 每个分片独立的读写锁; 查询只对一个分片加共享锁, 增删只对一个分片加独占锁,
+ * 大量 poller 线程同时查询不同平台时互不竞争; 分片按缓存行对齐, 避免锁之间的伪共享;
+ * 不是 20 位数字的编码放在单独的字符串表中, 按字符串查询的接口会自动选择所在的表
+ */
+template <typename T>
+class PlatformRegistry {
+public:
+    using Ptr = std::shared_ptr<T>;
+
+    Ptr find(const DeviceCode &code) const {
+        auto &shard = shard_of(code);
+        std::shared_lock<std::shared_mutex> lck(shard.mtx);
+        auto it = shard.map.find(code);
+        return it == shard.map.end() ? nullptr : it->second;
+    }
+
+    Ptr find(const std::string &id) const {
+        DeviceCode code;
+        if (DeviceCode::parse(id, code)) {
+            return find(code);
+        }
+        std::shared_lock<std::shared_mutex> lck(_others_mtx);
+        auto it = _others.find(id);
+        return it == _others.end() ? nullptr : it->second;
+    }
+
+    /**
+     * 加入平台, 已存在时替换
+     * @return 被替换的旧平台
+     */
+    Ptr assign(const DeviceCode &code, Ptr platform) {
+        auto &shard = shard_of(code);
+        std::unique_lock<std::shared_mutex> lck(shard.mtx);
+        auto &value = shard.map[code];
+        value.swap(platform);
+        return platform;
+    }
+
+    Ptr assign(const std::string &id, Ptr platform) {
+        DeviceCode code;
+        if (DeviceCode::parse(id, code)) {
+            return assign(code, std::move(platform));
+        }
+        std::unique_lock<std::shared_mutex> lck(_others_mtx);
+        _others[id].swap(platform);
+        return platform;
+    }
+
+    /**
+     * 批量加入平台, 已存在时替换; 按分片分组, 每个分片只加锁一次
+     * @return 被替换的旧平台
+     */
+    std::vector<Ptr> assign(std::vector<std::pair<DeviceCode, Ptr>> &&items) {
+        std::vector<std::vector<std::pair<DeviceCode, Ptr>>> groups(kShardCount);
+        for (auto &item : items) {
+            auto index = item.first.hash() % kShardCount;
+            groups[index].emplace_back(std::move(item));
+        }
+        std::vector<Ptr> replaced;
+        for (size_t i = 0; i < kShardCount; ++i) {
+            if (groups[i].empty()) {
+                continue;
+            }
+            auto &shard = _shards[i];
+            std::unique_lock<std::shared_mutex> lck(shard.mtx);
+            shard.map.reserve(shard.map.size() + groups[i].size());
+            for (auto &item : groups[i]) {
+                auto &value = shard.map[item.first];
+                if (value) {
+                    replaced.emplace_back(std::move(value));
+                }
+                value = std::move(item.second);
+            }
+        }
+        return replaced;
+    }
+
+    /**
+     * 平台不存在时加入
+     * @return 表中最终的平台
+     */
+    Ptr insert(const DeviceCode &code, const Ptr &platform) {
+        auto &shard = shard_of(code);
+        std::unique_lock<std::shared_mutex> lck(shard.mtx);
+        return shard.map.emplace(code, platform).first->second;
+    }
+
+    Ptr insert(const std::string &id, const Ptr &platform) {
+        DeviceCode code;
+        if (DeviceCode::parse(id, code)) {
+            return insert(code, platform);
+        }
+        std::unique_lock<std::shared_mutex> lck(_others_mtx);
+        return _others.emplace(id, platform).first->second;
+    }
+
+    /**
+     * 移除平台
+     * @return 被移除的平台, 由调用方在锁外关闭
+     */
+    Ptr remove(const DeviceCode &code) {
+        auto &shard = shard_of(code);
+        std::unique_lock<std::shared_mutex> lck(shard.mtx);
+        auto it = shard.map.find(code);
+        if (it == shard.map.end()) {
+            return nullptr;
+        }
+        auto platform = std::move(it->second);
+        shard.map.erase(it);
+        return platform;
+    }
+
+    Ptr remove(const std::string &id) {
+        DeviceCode code;
+        if (DeviceCode::parse(id, code)) {
+            return remove(code);
+        }
+        std::unique_lock<std::shared_mutex> lck(_others_mtx);
+        auto it = _others.find(id);
+        if (it == _others.end()) {
+            return nullptr;
+        }
+        auto platform = std::move(it->second);
+        _others.erase(it);
+        return platform;
+    }
+
+    template <typename Base = T>
+    std::vector<std::shared_ptr<Base>> all() const {
+        std::vector<std::shared_ptr<Base>> ret;
+        for (auto &shard : _shards) {
+            std::shared_lock<std::shared_mutex> lck(shard.mtx);
+            for (auto &it : shard.map) {
+                ret.emplace_back(it.second);
+            }
+        }
+        std::shared_lock<std::shared_mutex> lck(_others_mtx);
+        for (auto &it : _others) {
+            ret.emplace_back(it.second);
+        }
+        return ret;
+    }
+
+    /**
+     * 清空并返回所有平台
+     */
+    std::vector<Ptr> clear() {
+        std::vector<Ptr> ret;
+        for (auto &shard : _shards) {
+            std::unique_lock<std::shared_mutex> lck(shard.mtx);
+            for (auto &it : shard.map) {
+                ret.emplace_back(std::move(it.second));
+            }
+            shard.map.clear();
+        }
+        std::unique_lock<std::shared_mutex> lck(_others_mtx);
+        for (auto &it : _others) {
+            ret.emplace_back(std::move(it.second));
+        }
+        _others.clear();
+        return ret;
+    }
+
+    size_t size() const {
+        size_t ret = 0;
+        for (auto &shard : _shards) {
+            std::shared_lock<std::shared_mutex> lck(shard.mtx);
+            ret += shard.map.size();
+        }
+        std::shared_lock<std::shared_mutex> lck(_others_mtx);
+        return ret + _others.size();
+    }
+
+private:
+    static constexpr size_t kShardCount = 64;
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<DeviceCode, Ptr, DeviceCode::Hash> map;
+    };
+
+    Shard &shard_of(const DeviceCode &code) { return _shards[code.hash() % kShardCount]; }
+    const Shard &shard_of(const DeviceCode &code) const { return _shards[code.hash() % kShardCount]; }
+
+private:
+    Shard _shards[kShardCount];
+    mutable std::shared_mutex _others_mtx;
+    std::unordered_map<std::string, Ptr> _others; // 不是 20 位数字的编码
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_PLATFORM_REGISTRY_H
+
+/**********************************************************************************************************
+文件名称:   platform_registry.h
+创建时间:   26-10-17 下午9:40
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午9:40
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午9:40       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <Util/logger.h>
+#include <Util/uv_errno.h>
+
+#include "platform_snapshot.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+static constexpr char kMagic[4] = { 'G', 'B', 'P', 'S' };
+static constexpr uint32_t kVersion = 2;
+static constexpr uint32_t kInitCapacity = 1024;
+static constexpr size_t kHeaderSize = 64;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t record_size;
+};
+
+struct PlatformSnapshot::Record {
+    char id[20];
+    uint8_t used;
+    uint8_t status;
+    uint8_t encoding;
+    uint8_t family;
+    uint64_t register_time;
+    uint64_t keepalive_time;
+    uint16_t port; // 网络字节序
+    uint8_t reserved[2];
+    uint8_t ip[16];
+    uint32_t checksum; // 之前所有字段的校验值, 进程在写入槽位的过程中退出时可以识别出不完整的记录
+};
+
+// FNV-1a
+static uint32_t record_checksum(const void *data, size_t size) {
+    auto ptr = static_cast<const uint8_t *>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ ptr[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void PlatformSnapshot::encode(const DeviceCode &code, const State &state, Record &rec) {
+    static_assert(sizeof(Record) == 64, "snapshot record size must be 64");
+    memset(&rec, 0, sizeof(rec));
+    auto id = code.str();
+    memcpy(rec.id, id.data(), (std::min)(id.size(), sizeof(rec.id)));
+    rec.used = 1;
+    rec.status = static_cast<uint8_t>(state.status);
+    rec.encoding = static_cast<uint8_t>(state.encoding);
+    rec.register_time = state.register_time;
+    rec.keepalive_time = state.keepalive_time;
+    if (state.addr.ss_family == AF_INET) {
+        auto addr = reinterpret_cast<const struct sockaddr_in *>(&state.addr);
+        rec.family = 4;
+        rec.port = addr->sin_port;
+        memcpy(rec.ip, &addr->sin_addr, sizeof(addr->sin_addr));
+    } else if (state.addr.ss_family == AF_INET6) {
+        auto addr = reinterpret_cast<const struct sockaddr_in6 *>(&state.addr);
+        rec.family = 6;
+        rec.port = addr->sin6_port;
+        memcpy(rec.ip, &addr->sin6_addr, sizeof(addr->sin6_addr));
+    }
+    rec.checksum = record_checksum(&rec, offsetof(Record, checksum));
+}
+
+PlatformSnapshot::PlatformSnapshot(std::string path)
+    : _path(std::move(path)) {}
+
+PlatformSnapshot::~PlatformSnapshot() {
+    unmap();
+#if !defined(_WIN32)
+    if (_fd >= 0) {
+        ::close(_fd);
+    }
+#endif
+}
+
+bool PlatformSnapshot::open() {
+#if defined(_WIN32)
+    WarnL << "platform snapshot is not supported on this platform";
+    return false;
+#else
+    _fd = ::open(_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (_fd < 0) {
+        WarnL << "open platform snapshot " << _path << " failed: " << get_uv_errmsg();
+        return false;
+    }
+    struct stat st {};
+    fstat(_fd, &st);
+    uint32_t capacity = 0;
+    if (static_cast<size_t>(st.st_size) >= kHeaderSize) {
+        SnapshotHeader header {};
+        if (pread(_fd, &header, sizeof(header), 0) == sizeof(header) && !memcmp(header.magic, kMagic, sizeof(kMagic))
+            && header.version == kVersion && header.record_size == sizeof(Record)
+            && kHeaderSize + static_cast<size_t>(header.capacity) * sizeof(Record) <= static_cast<size_t>(st.st_size)) {
+            capacity = header.capacity;
+        } else {
+            WarnL << "platform snapshot " << _path << " is invalid, recreate it";
+        }
+    }
+    if (!map(capacity ? capacity : kInitCapacity)) {
+        return false;
+    }
+    if (!capacity) {
+        // 新建或无法识别的文件, 清空所有槽位
+        memset(_data + kHeaderSize, 0, _size - kHeaderSize);
+    }
+    size_t broken = 0;
+    for (uint32_t i = 0; i < _capacity; ++i) {
+        auto rec = record(i);
+        DeviceCode code;
+        if (rec->used && rec->checksum != record_checksum(rec, offsetof(Record, checksum))) {
+            // 写入中途退出的槽位, 内容不可信, 不恢复
+            ++broken;
+            rec->used = 0;
+            _free.emplace_back(i);
+        } else if (rec->used && DeviceCode::parse(rec->id, sizeof(rec->id), code) && _slots.emplace(code, i).second) {
+            _seen[i] = _round;
+            decode(*rec, _loaded[code]);
+        } else {
+            rec->used = 0;
+            _free.emplace_back(i);
+        }
+    }
+    // 优先使用低位槽位
+    std::reverse(_free.begin(), _free.end());
+    if (broken) {
+        WarnL << "platform snapshot " << _path << " has " << broken << " broken records, ignored";
+    }
+    InfoL << "platform snapshot " << _path << " loaded, platforms: " << _slots.size();
+    return true;
+#endif
+}
+
+bool PlatformSnapshot::take(const DeviceCode &code, State &state) {
+    auto it = _loaded.find(code);
+    if (it == _loaded.end()) {
+        return false;
+    }
+    state = it->second;
+    _loaded.erase(it);
+    return true;
+}
+
+void PlatformSnapshot::update(const DeviceCode &code, const State &state) {
+    if (!_data) {
+        return;
+    }
+    uint32_t index = 0;
+    auto it = _slots.find(code);
+    if (it != _slots.end()) {
+        index = it->second;
+    } else if (alloc(index)) {
+        _slots.emplace(code, index);
+    } else {
+        return;
+    }
+    _seen[index] = _round;
+    Record rec;
+    encode(code, state, rec);
+    // 内容未变化时不写入, 避免产生脏页
+    auto slot = record(index);
+    if (memcmp(slot, &rec, sizeof(rec))) {
+        memcpy(slot, &rec, sizeof(rec));
+    }
+}
+
+void PlatformSnapshot::remove(const DeviceCode &code) {
+    _loaded.erase(code);
+    auto it = _slots.find(code);
+    if (!_data || it == _slots.end()) {
+        return;
+    }
+    record(it->second)->used = 0;
+    _free.emplace_back(it->second);
+    _slots.erase(it);
+}
+
+void PlatformSnapshot::commit() {
+    if (!_data) {
+        return;
+    }
+    for (auto it = _slots.begin(); it != _slots.end();) {
+        if (_seen[it->second] != _round && !_loaded.count(it->first)) {
+            // 本轮未更新且状态已取出的平台已被移除
+            record(it->second)->used = 0;
+            _free.emplace_back(it->second);
+            it = _slots.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    ++_round;
+#if !defined(_WIN32)
+    msync(_data, _size, MS_ASYNC);
+#endif
+}
+
+bool PlatformSnapshot::map(uint32_t capacity) {
+#if defined(_WIN32)
+    return false;
+#else
+    auto size = kHeaderSize + static_cast<size_t>(capacity) * sizeof(Record);
+    if (ftruncate(_fd, static_cast<off_t>(size)) != 0) {
+        WarnL << "resize platform snapshot " << _path << " failed: " << get_uv_errmsg();
+        return false;
+    }
+    auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED) {
+        WarnL << "mmap platform snapshot " << _path << " failed: " << get_uv_errmsg();
+        return false;
+    }
+    unmap();
+    _data = static_cast<char *>(data);
+    _size = size;
+    _capacity = capacity;
+    _seen.resize(capacity, 0);
+    SnapshotHeader header {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.capacity = capacity;
+    header.record_size = sizeof(Record);
+    memcpy(_data, &header, sizeof(header));
+    return true;
+#endif
+}
+
+void PlatformSnapshot::unmap() {
+#if !defined(_WIN32)
+    if (_data) {
+        munmap(_data, _size);
+        _data = nullptr;
+        _size = 0;
+    }
+#endif
+}
+
+PlatformSnapshot::Record *PlatformSnapshot::record(uint32_t index) const {
+    return reinterpret_cast<Record *>(_data + kHeaderSize + static_cast<size_t>(index) * sizeof(Record));
+}
+
+bool PlatformSnapshot::alloc(uint32_t &index) {
+    if (_free.empty()) {
+        // 槽位用尽时按倍数扩容, 新增的槽位由 ftruncate 填零
+        auto old_capacity = _capacity;
+        if (!map(old_capacity * 2)) {
+            return false;
+        }
+        for (auto i = _capacity; i > old_capacity; --i) {
+            _free.emplace_back(i - 1);
+        }
+    }
+    index = _free.back();
+    _free.pop_back();
+    return true;
+}
+
+void PlatformSnapshot::decode(const Record &rec, State &state) {
+    state.status = static_cast<PlatformStatusType>(rec.status);
+    state.encoding = static_cast<CharEncodingType>(rec.encoding);
+    state.register_time = rec.register_time;
+    state.keepalive_time = rec.keepalive_time;
+    memset(&state.addr, 0, sizeof(state.addr));
+    if (rec.family == 4) {
+        auto addr = reinterpret_cast<struct sockaddr_in *>(&state.addr);
+        addr->sin_family = AF_INET;
+        addr->sin_port = rec.port;
+        memcpy(&addr->sin_addr, rec.ip, sizeof(addr->sin_addr));
+    } else if (rec.family == 6) {
+        auto addr = reinterpret_cast<struct sockaddr_in6 *>(&state.addr);
+        addr->sin6_family = AF_INET6;
+        addr->sin6_port = rec.port;
+        memcpy(&addr->sin6_addr, rec.ip, sizeof(addr->sin6_addr));
+    }
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   platform_snapshot.cpp
+创建时间:   26-10-17 下午10:30
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午10:30
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午10:30       描述:   创建文件
+
+**********************************************************************************************************/
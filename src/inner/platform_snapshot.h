@@ -0,0 +1,99 @@
+#ifndef gb28181_src_inner_PLATFORM_SNAPSHOT_H
+#define gb28181_src_inner_PLATFORM_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Network/sockutil.h"
+#include "device_code.h"
+#include "gb28181/type_define.h"
+
+namespace gb28181 {
+
+/**
+ * 下级平台状态快照
+ * 快照文件通过 mmap 映射, 每个平台占用一个固定长度的槽位; 定期写入时只改写内容变化的槽位,
+ * 由内核按脏页回写; 重启后读取快照恢复平台的在线状态、联系地址与字符集, 不必等待设备重新注册
+ */
+class PlatformSnapshot {
+public:
+    struct State {
+        PlatformStatusType status { PlatformStatusType::offline };
+        CharEncodingType encoding { CharEncodingType::invalid };
+        uint64_t register_time { 0 }; // 注册时间(系统时间, 微秒)
+        uint64_t keepalive_time { 0 }; // 心跳时间(系统时间, 微秒)
+        struct sockaddr_storage addr {}; // 平台联系地址
+    };
+
+    explicit PlatformSnapshot(std::string path);
+    ~PlatformSnapshot();
+
+    PlatformSnapshot(const PlatformSnapshot &) = delete;
+    PlatformSnapshot &operator=(const PlatformSnapshot &) = delete;
+
+    /**
+     * 打开或创建快照文件, 读取已有的平台状态
+     */
+    bool open();
+
+    /**
+     * 取出打开文件时读取到的平台状态, 每个平台只能取出一次
+     */
+    bool take(const DeviceCode &code, State &state);
+
+    /**
+     * 写入一个平台的状态, 内容未变化时不改写
+     */
+    void update(const DeviceCode &code, const State &state);
+
+    /**
+     * 移除平台, 释放其槽位并丢弃尚未取出的状态
+     */
+    void remove(const DeviceCode &code);
+
+    /**
+     * 结束一轮写入: 释放本轮未更新且状态已取出的平台槽位, 并异步刷新到磁盘;
+     * 尚未取出的平台(重启后还没有添加)保留槽位, 直到取出或移除
+     */
+    void commit();
+
+private:
+    struct Record;
+    static void encode(const DeviceCode &code, const State &state, Record &rec);
+    static void decode(const Record &rec, State &state);
+    bool map(uint32_t capacity);
+    void unmap();
+    Record *record(uint32_t index) const;
+    bool alloc(uint32_t &index);
+
+private:
+    std::string _path;
+    int _fd { -1 };
+    char *_data { nullptr };
+    size_t _size { 0 };
+    uint32_t _capacity { 0 };
+    std::unordered_map<DeviceCode, uint32_t, DeviceCode::Hash> _slots; // 平台 -> 槽位
+    std::unordered_map<DeviceCode, State, DeviceCode::Hash> _loaded; // 打开时读取到、尚未恢复的平台状态
+    std::vector<uint32_t> _free; // 空闲槽位
+    std::vector<uint32_t> _seen; // 槽位最后一次更新的轮次
+    uint32_t _round { 1 };
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_PLATFORM_SNAPSHOT_H
+
+/**********************************************************************************************************
+文件名称:   platform_snapshot.h
+创建时间:   26-10-17 下午10:30
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午10:30
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午10:30       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "sip_admission.h"
+
+namespace gb28181 {
+
+// 桶满且超过该时长未访问的来源将被清理
+static constexpr uint64_t kIdleTimeoutUS = 60 * 1000 * 1000;
+// 分片内清理的最小间隔
+static constexpr uint64_t kSweepIntervalUS = 10 * 1000 * 1000;
+// 分片内桶数超过该值时才清理
+static constexpr size_t kSweepThreshold = 1024;
+
+static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void SipAdmission::set_rate(uint32_t register_rate, uint32_t message_rate, uint32_t burst) {
+    _register_rate.store(register_rate, std::memory_order_relaxed);
+    _message_rate.store(message_rate, std::memory_order_relaxed);
+    _burst.store((std::max)(burst, 1u), std::memory_order_relaxed);
+}
+
+SipAdmission::Method SipAdmission::sniff_method(const char *data, size_t size) {
+    static constexpr std::string_view kRegister = "REGISTER ";
+    static constexpr std::string_view kMessage = "MESSAGE ";
+    std::string_view line(data, size);
+    if (line.substr(0, kRegister.size()) == kRegister) {
+        return Method::register_;
+    }
+    if (line.substr(0, kMessage.size()) == kMessage) {
+        return Method::message;
+    }
+    return Method::other;
+}
+
+bool SipAdmission::admit(Method method, const struct sockaddr_storage &addr) {
+    uint32_t rate = 0;
+    switch (method) {
+        case Method::register_: rate = _register_rate.load(std::memory_order_relaxed); break;
+        case Method::message: rate = _message_rate.load(std::memory_order_relaxed); break;
+        default: break;
+    }
+    if (rate == 0) {
+        return true;
+    }
+    Key key;
+    key.method = method;
+    if (addr.ss_family == AF_INET) {
+        auto addr4 = reinterpret_cast<const struct sockaddr_in *>(&addr);
+        memcpy(key.addr, &addr4->sin_addr, 4);
+        key.port = addr4->sin_port;
+    } else if (addr.ss_family == AF_INET6) {
+        auto addr6 = reinterpret_cast<const struct sockaddr_in6 *>(&addr);
+        memcpy(key.addr, &addr6->sin6_addr, 16);
+        key.port = addr6->sin6_port;
+    } else {
+        return true;
+    }
+    auto burst = static_cast<double>(_burst.load(std::memory_order_relaxed));
+    auto now = now_us();
+    auto &shard = _shards[KeyHash()(key) % kShardCount];
+    std::lock_guard<std::mutex> lck(shard.mtx);
+    auto result = shard.buckets.emplace(key, Bucket());
+    auto &bucket = result.first->second;
+    if (result.second) {
+        bucket.tokens = burst;
+    } else {
+        bucket.tokens = (std::min)(burst, bucket.tokens + (now - bucket.last_us) * rate / 1e6);
+    }
+    bucket.last_us = now;
+    bool admitted = bucket.tokens >= 1.0;
+    if (admitted) {
+        bucket.tokens -= 1.0;
+    } else {
+        _rejected.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (shard.buckets.size() > kSweepThreshold && now - shard.last_sweep_us > kSweepIntervalUS) {
+        sweep(shard, now);
+    }
+    return admitted;
+}
+
+void SipAdmission::sweep(Shard &shard, uint64_t now_us) {
+    shard.last_sweep_us = now_us;
+    for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+        // 长时间未访问的来源, 令牌早已回满, 删除后再次访问时等价
+        if (now_us - it->second.last_us > kIdleTimeoutUS) {
+            it = shard.buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_admission.cpp
+创建时间:   26-10-17 下午4:20
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午4:20
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午4:20       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,96 @@
+#ifndef gb28181_src_inner_SIP_ADMISSION_H
+#define gb28181_src_inner_SIP_ADMISSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "Network/sockutil.h"
+
+namespace gb28181 {
+
+/**
+ * 接收准入控制
+ * 在解析消息之前, 根据起始行中的请求方法与来源地址执行令牌桶限速,
+ * 注册风暴期间可以以极低的代价拒绝超出速率的请求
+ */
+class SipAdmission {
+public:
+    enum class Method : uint8_t { other = 0, register_, message };
+
+    /**
+     * @param register_rate 单个来源每秒允许的 REGISTER 数, 为 0 时不限制
+     * @param message_rate 单个来源每秒允许的 MESSAGE 数, 为 0 时不限制
+     * @param burst 令牌桶容量
+     */
+    void set_rate(uint32_t register_rate, uint32_t message_rate, uint32_t burst);
+
+    /**
+     * 从起始行识别请求方法
+     */
+    static Method sniff_method(const char *data, size_t size);
+
+    /**
+     * 判断请求是否允许进入解析
+     * @return 超出速率时返回 false
+     */
+    bool admit(Method method, const struct sockaddr_storage &addr);
+
+    uint64_t rejected_count() const { return _rejected.load(std::memory_order_relaxed); }
+
+private:
+    struct Key {
+        uint8_t addr[16] {};
+        uint16_t port { 0 };
+        Method method { Method::other };
+        bool operator==(const Key &other) const {
+            return port == other.port && method == other.method && memcmp(addr, other.addr, sizeof(addr)) == 0;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return std::hash<std::string_view>()(std::string_view((const char *)key.addr, sizeof(key.addr)))
+                ^ (static_cast<size_t>(key.port) << 8 | static_cast<size_t>(key.method));
+        }
+    };
+    struct Bucket {
+        double tokens { 0 };
+        uint64_t last_us { 0 };
+    };
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<Key, Bucket, KeyHash> buckets;
+        uint64_t last_sweep_us { 0 };
+    };
+    static constexpr size_t kShardCount = 16;
+
+    void sweep(Shard &shard, uint64_t now_us);
+
+private:
+    std::atomic<uint32_t> _register_rate { 0 };
+    std::atomic<uint32_t> _message_rate { 0 };
+    std::atomic<uint32_t> _burst { 10 };
+    std::atomic<uint64_t> _rejected { 0 };
+    Shard _shards[kShardCount];
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_ADMISSION_H
+
+/**********************************************************************************************************
+文件名称:   sip_admission.h
+创建时间:   26-10-17 下午4:20
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午4:20
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午4:20       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,257 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+#include <Thread/WorkThreadPool.h>
+#include <Util/logger.h>
+
+#include "sip_capture.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+// 槽位数量, 必须为 2 的幂
+static constexpr size_t kSlotCount = 2048;
+// 单条报文最大保存长度
+static constexpr size_t kSlotDataSize = 2048;
+// pcap LINKTYPE_RAW, 报文以 ip 头开始
+static constexpr uint32_t kLinkTypeRaw = 101;
+
+struct SipCapture::Slot {
+    // 奇数表示正在写入, 偶数为 2 * (序号 + 1) 表示写入完成
+    std::atomic<uint64_t> seq { 0 };
+    uint64_t time_us { 0 };
+    uint32_t orig_len { 0 };
+    uint32_t cap_len { 0 };
+    uint16_t peer_family { 0 };
+    uint16_t peer_port { 0 }; // 网络字节序
+    uint16_t local_port { 0 }; // 网络字节序
+    uint8_t direction { 0 };
+    uint8_t is_udp { 0 };
+    uint8_t peer_addr[16] {};
+    char data[kSlotDataSize];
+};
+
+SipCapture &SipCapture::Instance() {
+    static SipCapture instance;
+    return instance;
+}
+
+void SipCapture::set_enabled(bool enable) {
+    if (enable) {
+        std::call_once(_alloc_flag, [this]() { _slots.reset(new Slot[kSlotCount]); });
+    }
+    _enabled.store(enable, std::memory_order_release);
+}
+
+void SipCapture::write(
+    Direction direction, bool is_udp, const struct sockaddr *peer, uint16_t local_port, const char *data,
+    size_t size) {
+    if (!_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+    auto index = _head.fetch_add(1, std::memory_order_relaxed);
+    auto &slot = _slots[index & (kSlotCount - 1)];
+    slot.seq.store(index * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+    slot.orig_len = static_cast<uint32_t>(size);
+    slot.cap_len = static_cast<uint32_t>((std::min)(size, kSlotDataSize));
+    slot.direction = static_cast<uint8_t>(direction);
+    slot.is_udp = is_udp;
+    slot.local_port = htons(local_port);
+    slot.peer_family = peer ? peer->sa_family : 0;
+    if (slot.peer_family == AF_INET) {
+        auto addr4 = reinterpret_cast<const struct sockaddr_in *>(peer);
+        slot.peer_port = addr4->sin_port;
+        memcpy(slot.peer_addr, &addr4->sin_addr, 4);
+    } else if (slot.peer_family == AF_INET6) {
+        auto addr6 = reinterpret_cast<const struct sockaddr_in6 *>(peer);
+        slot.peer_port = addr6->sin6_port;
+        memcpy(slot.peer_addr, &addr6->sin6_addr, 16);
+    } else {
+        slot.peer_family = AF_INET;
+        slot.peer_port = 0;
+        memset(slot.peer_addr, 0, sizeof(slot.peer_addr));
+    }
+    memcpy(slot.data, data, slot.cap_len);
+
+    slot.seq.store(index * 2 + 2, std::memory_order_release);
+
+    if (_has_trigger.load(std::memory_order_relaxed)) {
+        check_trigger(data, slot.cap_len);
+    }
+}
+
+void SipCapture::set_trigger(const std::string &platform_id, const std::string &path) {
+    std::lock_guard<std::mutex> lck(_trigger_mutex);
+    _trigger_id = platform_id;
+    _trigger_path = path;
+    _has_trigger.store(!platform_id.empty() && !path.empty(), std::memory_order_relaxed);
+}
+
+void SipCapture::check_trigger(const char *data, size_t size) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lck(_trigger_mutex);
+        if (_trigger_id.empty() || std::string_view(data, size).find(_trigger_id) == std::string_view::npos) {
+            return;
+        }
+        // 只触发一次
+        path = std::move(_trigger_path);
+        _trigger_id.clear();
+        _trigger_path.clear();
+        _has_trigger.store(false, std::memory_order_relaxed);
+    }
+    WorkThreadPool::Instance().getExecutor()->async([path]() {
+        if (SipCapture::Instance().dump(path)) {
+            InfoL << "sip capture triggered, saved to " << path;
+        }
+    });
+}
+
+static uint16_t ip_checksum(const uint8_t *data, size_t size) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        sum += (data[i] << 8) | data[i + 1];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return htons(static_cast<uint16_t>(~sum));
+}
+
+// 构造 ip + udp 头, 返回头部长度; tcp 报文同样以 udp 头封装, 便于 wireshark 按消息解析 sip
+static size_t make_header(
+    uint8_t *header, uint16_t family, const uint8_t *src, uint16_t src_port, const uint8_t *dst, uint16_t dst_port,
+    size_t payload_size) {
+    size_t ip_size = family == AF_INET6 ? 40 : 20;
+    auto udp_size = static_cast<uint16_t>((std::min)(payload_size + 8, static_cast<size_t>(0xFFFF)));
+    if (family == AF_INET6) {
+        memset(header, 0, 40);
+        header[0] = 0x60;
+        header[4] = udp_size >> 8;
+        header[5] = udp_size & 0xFF;
+        header[6] = IPPROTO_UDP;
+        header[7] = 64;
+        memcpy(header + 8, src, 16);
+        memcpy(header + 24, dst, 16);
+    } else {
+        auto total = static_cast<uint16_t>((std::min)(payload_size + 28, static_cast<size_t>(0xFFFF)));
+        memset(header, 0, 20);
+        header[0] = 0x45;
+        header[2] = total >> 8;
+        header[3] = total & 0xFF;
+        header[8] = 64;
+        header[9] = IPPROTO_UDP;
+        memcpy(header + 12, src, 4);
+        memcpy(header + 16, dst, 4);
+        auto checksum = ip_checksum(header, 20);
+        memcpy(header + 10, &checksum, 2);
+    }
+    auto udp = header + ip_size;
+    memcpy(udp, &src_port, 2);
+    memcpy(udp + 2, &dst_port, 2);
+    udp[4] = udp_size >> 8;
+    udp[5] = udp_size & 0xFF;
+    udp[6] = udp[7] = 0; // 不计算校验和
+    return ip_size + 8;
+}
+
+bool SipCapture::dump(const std::string &path) const {
+    if (!_slots) {
+        WarnL << "sip capture is not enabled";
+        return false;
+    }
+    auto fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        WarnL << "open " << path << " failed";
+        return false;
+    }
+    struct {
+        uint32_t magic = 0xa1b2c3d4;
+        uint16_t version_major = 2;
+        uint16_t version_minor = 4;
+        int32_t thiszone = 0;
+        uint32_t sigfigs = 0;
+        uint32_t snaplen = kSlotDataSize + 48;
+        uint32_t network = kLinkTypeRaw;
+    } file_header;
+    fwrite(&file_header, sizeof(file_header), 1, fp);
+
+    static const uint8_t kAnyAddr[16] {};
+    auto head = _head.load(std::memory_order_acquire);
+    auto begin = head > kSlotCount ? head - kSlotCount : 0;
+    auto slot_copy = std::make_unique<Slot>();
+    uint8_t header[48];
+    size_t count = 0;
+    for (auto index = begin; index < head; ++index) {
+        auto &slot = _slots[index & (kSlotCount - 1)];
+        auto seq = slot.seq.load(std::memory_order_acquire);
+        if (seq != index * 2 + 2) {
+            // 正在写入或已被覆盖
+            continue;
+        }
+        slot_copy->time_us = slot.time_us;
+        slot_copy->orig_len = slot.orig_len;
+        slot_copy->cap_len = (std::min)(slot.cap_len, static_cast<uint32_t>(kSlotDataSize));
+        slot_copy->peer_family = slot.peer_family;
+        slot_copy->peer_port = slot.peer_port;
+        slot_copy->local_port = slot.local_port;
+        slot_copy->direction = slot.direction;
+        memcpy(slot_copy->peer_addr, slot.peer_addr, sizeof(slot.peer_addr));
+        memcpy(slot_copy->data, slot.data, slot_copy->cap_len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq) {
+            continue;
+        }
+        // 本地地址未记录, 以全 0 地址代替
+        size_t header_size;
+        if (slot_copy->direction == static_cast<uint8_t>(Direction::in)) {
+            header_size = make_header(
+                header, slot_copy->peer_family, slot_copy->peer_addr, slot_copy->peer_port, kAnyAddr,
+                slot_copy->local_port, slot_copy->orig_len);
+        } else {
+            header_size = make_header(
+                header, slot_copy->peer_family, kAnyAddr, slot_copy->local_port, slot_copy->peer_addr,
+                slot_copy->peer_port, slot_copy->orig_len);
+        }
+        struct {
+            uint32_t ts_sec;
+            uint32_t ts_usec;
+            uint32_t incl_len;
+            uint32_t orig_len;
+        } record_header { static_cast<uint32_t>(slot_copy->time_us / 1000000),
+                          static_cast<uint32_t>(slot_copy->time_us % 1000000),
+                          static_cast<uint32_t>(header_size + slot_copy->cap_len),
+                          static_cast<uint32_t>(header_size + slot_copy->orig_len) };
+        fwrite(&record_header, sizeof(record_header), 1, fp);
+        fwrite(header, header_size, 1, fp);
+        fwrite(slot_copy->data, slot_copy->cap_len, 1, fp);
+        ++count;
+    }
+    fclose(fp);
+    InfoL << "dump " << count << " sip messages to " << path;
+    return true;
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_capture.cpp
+创建时间:   26-10-17 下午3:10
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午3:10
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午3:10       描述:   创建文件
+
+**********************************************************************************************************/
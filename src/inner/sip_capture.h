@@ -0,0 +1,83 @@
+#ifndef gb28181_src_inner_SIP_CAPTURE_H
+#define gb28181_src_inner_SIP_CAPTURE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "Network/sockutil.h"
+
+namespace gb28181 {
+
+/**
+ * sip 报文抓包环形缓冲
+ * 固定数量的槽位, 写入方通过原子序号领取槽位并以 seqlock 方式写入, 不加锁;
+ * 导出时按序号顺序读取, 跳过正在被覆盖的槽位, 输出为 pcap(LINKTYPE_RAW) 文件
+ */
+class SipCapture {
+public:
+    enum class Direction : uint8_t { in = 0, out = 1 };
+
+    static SipCapture &Instance();
+
+    /**
+     * 开启或关闭抓包, 首次开启时分配缓冲
+     */
+    void set_enabled(bool enable);
+    inline bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * 写入一条报文, 超过槽位大小的部分被截断
+     * @param peer 对端地址
+     * @param local_port 本地端口
+     */
+    void write(
+        Direction direction, bool is_udp, const struct sockaddr *peer, uint16_t local_port, const char *data,
+        size_t size);
+
+    /**
+     * 导出当前缓冲中的报文为 pcap 文件
+     */
+    bool dump(const std::string &path) const;
+
+    /**
+     * 设置导出触发条件, 报文中出现指定平台编码时自动导出一次
+     * @param platform_id 平台编码, 为空时取消触发
+     * @param path 导出文件路径
+     */
+    void set_trigger(const std::string &platform_id, const std::string &path);
+
+private:
+    SipCapture() = default;
+    void check_trigger(const char *data, size_t size);
+
+private:
+    struct Slot;
+    std::atomic_bool _enabled { false };
+    std::atomic<uint64_t> _head { 0 };
+    std::unique_ptr<Slot[]> _slots;
+    std::once_flag _alloc_flag;
+
+    std::atomic_bool _has_trigger { false };
+    std::mutex _trigger_mutex;
+    std::string _trigger_id;
+    std::string _trigger_path;
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_CAPTURE_H
+
+/**********************************************************************************************************
+文件名称:   sip_capture.h
+创建时间:   26-10-17 下午3:10
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午3:10
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午3:10       描述:   创建文件
+
+**********************************************************************************************************/
@@ -121,6 +121,9 @@ void set_message_date(struct sip_uas_transaction_t *transaction) {
 void set_message_expires(struct sip_uas_transaction_t *transaction, int expires) {
     sip_uas_add_header_int(transaction, SIP_HEADER_EXPIRES, expires);
 }
+void set_message_retry_after(struct sip_uas_transaction_t *transaction, int seconds) {
+    sip_uas_add_header_int(transaction, "Retry-After", seconds);
+}
 
 void set_message_header(struct sip_uas_transaction_t *transaction) {
     set_message_agent(transaction);
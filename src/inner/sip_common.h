@@ -68,6 +68,7 @@ void set_message_gbt_version(
     struct sip_uas_transaction_t *transaction, PlatformVersionType version = PlatformVersionType::v30);
 void set_message_date(struct sip_uas_transaction_t *transaction);
 void set_message_expires(struct sip_uas_transaction_t *transaction, int expires);
+void set_message_retry_after(struct sip_uas_transaction_t *transaction, int seconds);
 void set_message_header(struct sip_uas_transaction_t *transaction);
 void set_message_content_type(struct sip_uas_transaction_t *transaction, enum SipContentType content_type);
 void set_message_reason(struct sip_uas_transaction_t *transaction, const char *reason);
@@ -0,0 +1,84 @@
+#include "sip_egress.h"
+#include "gb28181/type_define.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+std::atomic<uint64_t> SipEgress::s_queue_depth[SipEgress::kHistogramBuckets] {};
+std::atomic<uint64_t> SipEgress::s_flush_size[SipEgress::kHistogramBuckets] {};
+
+static void add_histogram(std::atomic<uint64_t> *histogram, size_t value) {
+    size_t bucket = 0;
+    while (value > 1 && bucket + 1 < SipEgress::kHistogramBuckets) {
+        value >>= 1;
+        ++bucket;
+    }
+    histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+SipEgress &SipEgress::Instance() {
+    static thread_local SipEgress instance;
+    return instance;
+}
+
+void SipEgress::send(const Socket::Ptr &sock, Buffer::Ptr buffer, struct sockaddr *addr, socklen_t addr_len) {
+    // 只写入发送缓存, 不立即触发系统调用
+    if (sock->send(std::move(buffer), addr, addr_len, false) < 0) {
+        return;
+    }
+    auto it = _index.find(sock.get());
+    if (it == _index.end()) {
+        _index.emplace(sock.get(), _pending.size());
+        _pending.push_back({ sock, 1 });
+    } else {
+        ++_pending[it->second].count;
+    }
+    ++_queued;
+    if (_scheduled) {
+        return;
+    }
+    _scheduled = true;
+    // 不允许同步执行, 保证在本轮事件处理完成后刷新
+    EventPoller::getCurrentPoller()->async([this]() { flush(); }, false);
+}
+
+void SipEgress::flush() {
+    _scheduled = false;
+    if (_pending.empty()) {
+        return;
+    }
+    add_histogram(s_queue_depth, _queued);
+    // 先交换出来, 刷新过程中触发的回调可能会再次写入
+    auto pending = std::move(_pending);
+    _pending.clear();
+    _index.clear();
+    _queued = 0;
+    for (auto &item : pending) {
+        add_histogram(s_flush_size, item.count);
+        item.sock->flushAll();
+    }
+}
+
+void SipEgress::get_statistics(server_statistics &statistics) {
+    for (size_t i = 0; i < kHistogramBuckets; ++i) {
+        statistics.egress_queue_depth[i] = s_queue_depth[i].load(std::memory_order_relaxed);
+        statistics.egress_flush_size[i] = s_flush_size[i].load(std::memory_order_relaxed);
+    }
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_egress.cpp
+创建时间:   26-10-17 下午2:30
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午2:30
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午2:30       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,74 @@
+#ifndef gb28181_src_inner_SIP_EGRESS_H
+#define gb28181_src_inner_SIP_EGRESS_H
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Network/Socket.h"
+
+namespace gb28181 {
+struct server_statistics;
+
+/**
+ * sip 发送合批队列
+ * 每个 poller 线程独享一个队列, 同一轮事件循环内产生的消息只写入 socket 的发送缓存,
+ * 本轮结束后对每个 socket 统一刷新一次, 由 toolkit 合并为 sendmmsg(udp) 或 sendmsg 聚集写(tcp)
+ */
+class SipEgress {
+public:
+    // 直方图桶数, 第 i 个桶统计取值在 [2^i, 2^(i+1)) 的次数, 最后一个桶包含更大的值
+    static constexpr size_t kHistogramBuckets = 8;
+
+    /**
+     * 获取当前线程的发送队列, 必须在 poller 线程内调用
+     */
+    static SipEgress &Instance();
+
+    /**
+     * 将消息放入 socket 发送缓存, 本轮事件循环结束后统一刷新
+     * @param addr 目标地址, 已连接的 socket 传 nullptr
+     */
+    void send(const toolkit::Socket::Ptr &sock, toolkit::Buffer::Ptr buffer, struct sockaddr *addr, socklen_t addr_len);
+
+    /**
+     * 所有线程累计的队列深度与单次刷新大小直方图
+     */
+    static void get_statistics(server_statistics &statistics);
+
+private:
+    SipEgress() = default;
+    void flush();
+
+private:
+    struct Pending {
+        toolkit::Socket::Ptr sock;
+        size_t count { 0 };
+    };
+    std::vector<Pending> _pending;
+    // socket -> _pending 下标
+    std::unordered_map<toolkit::Socket *, size_t> _index;
+    size_t _queued { 0 };
+    bool _scheduled { false };
+
+    static std::atomic<uint64_t> s_queue_depth[kHistogramBuckets];
+    static std::atomic<uint64_t> s_flush_size[kHistogramBuckets];
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_EGRESS_H
+
+/**********************************************************************************************************
+文件名称:   sip_egress.h
+创建时间:   26-10-17 下午2:30
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午2:30
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午2:30       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string_view>
+
+#include "sip_framer.h"
+
+namespace gb28181 {
+
+// 查找起始行时, 单行数据的最大长度
+static constexpr size_t kMaxStartLineSize = 8 * 1024;
+// 超长消息可跳过的最大消息体长度, 声明的长度超过该值时不再等待跳过, 视为数据错误
+static constexpr size_t kMaxDiscardSize = 16 * 1024 * 1024;
+static constexpr std::string_view kSipVersion = "SIP/2.0";
+
+bool SipFramer::is_header(const char *line, size_t size, std::string_view name, size_t &value_pos) {
+    if (size <= name.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) {
+            return false;
+        }
+    }
+    auto pos = name.size();
+    while (pos < size && std::isblank(static_cast<unsigned char>(line[pos]))) {
+        ++pos;
+    }
+    if (pos >= size || line[pos] != ':') {
+        return false;
+    }
+    value_pos = pos + 1;
+    return true;
+}
+
+SipFramer::SipFramer(size_t max_message_size)
+    : _max_message_size(max_message_size) {}
+
+SipFramer::MessageType SipFramer::check_start_line(const char *line, size_t size) {
+    std::string_view data(line, size);
+    // SIP/2.0 200 OK
+    if (data.size() >= kSipVersion.size() + 4 && data.substr(0, kSipVersion.size()) == kSipVersion) {
+        auto status = kSipVersion.size() + 1;
+        if (std::isblank(static_cast<unsigned char>(data[kSipVersion.size()]))
+            && std::isdigit(static_cast<unsigned char>(data[status]))
+            && std::isdigit(static_cast<unsigned char>(data[status + 1]))
+            && std::isdigit(static_cast<unsigned char>(data[status + 2]))) {
+            return MessageType::response;
+        }
+        return MessageType::unknown;
+    }
+    // METHOD sip:xxxxxxxxx SIP/2.0
+    if (data.size() <= kSipVersion.size() + 2 || data.substr(data.size() - kSipVersion.size()) != kSipVersion
+        || !std::isblank(static_cast<unsigned char>(data[data.size() - kSipVersion.size() - 1]))) {
+        return MessageType::unknown;
+    }
+    size_t method_size = 0;
+    while (method_size < data.size() && std::isupper(static_cast<unsigned char>(data[method_size]))) {
+        ++method_size;
+    }
+    if (method_size == 0 || !std::isblank(static_cast<unsigned char>(data[method_size]))) {
+        return MessageType::unknown;
+    }
+    return MessageType::request;
+}
+
+void SipFramer::input(const char *data, size_t size) {
+    if (_discard) {
+        // 丢弃超长消息剩余的消息体, 此时缓存中没有未消费的数据
+        auto discard = (std::min)(_discard, size);
+        _discard -= discard;
+        data += discard;
+        size -= discard;
+    }
+    if (size == 0) {
+        return;
+    }
+    reserve(size);
+    memcpy(_buffer.get() + _write, data, size);
+    _write += size;
+}
+
+void SipFramer::reserve(size_t size) {
+    if (_capacity - _write >= size) {
+        return;
+    }
+    auto remain = _write - _read;
+    // 前移未消费的数据, 所有位置同步平移
+    if (_read > 0) {
+        if (remain) {
+            memmove(_buffer.get(), _buffer.get() + _read, remain);
+        }
+        _scan -= _read;
+        _body = _body > _read ? _body - _read : 0;
+        _write = remain;
+        _read = 0;
+    }
+    if (_capacity - _write >= size) {
+        return;
+    }
+    auto capacity = (std::max)(_capacity * 2, static_cast<size_t>(4 * 1024));
+    while (capacity - _write < size) {
+        capacity *= 2;
+    }
+    std::unique_ptr<char[]> buffer(new char[capacity]);
+    if (_write) {
+        memcpy(buffer.get(), _buffer.get(), _write);
+    }
+    _buffer = std::move(buffer);
+    _capacity = capacity;
+}
+
+void SipFramer::reset_state() {
+    _state = State::start_line;
+    _type = MessageType::unknown;
+    _scan = _read;
+    _body = 0;
+    _content_length = 0;
+}
+
+void SipFramer::clear() {
+    _read = _write = 0;
+    _discard = 0;
+    _error = false;
+    reset_state();
+}
+
+bool SipFramer::scan_start_line() {
+    auto base = _buffer.get();
+    while (_scan < _write) {
+        auto end = static_cast<const char *>(memchr(base + _scan, '\n', _write - _scan));
+        if (end == nullptr) {
+            // 没有找到完整的一行, 数据过长则视为无效数据丢弃
+            if (_write - _read > kMaxStartLineSize) {
+                _read = _write;
+            }
+            _scan = _write;
+            return false;
+        }
+        auto line_end = static_cast<size_t>(end - base);
+        auto size = line_end - _read;
+        if (size && base[line_end - 1] == '\r') {
+            --size;
+        }
+        _type = size ? check_start_line(base + _read, size) : MessageType::unknown;
+        _scan = line_end + 1;
+        if (_type != MessageType::unknown) {
+            _state = State::headers;
+            return true;
+        }
+        // 空行(tcp 保活) 或者无效行, 直接丢弃
+        _read = _scan;
+    }
+    return false;
+}
+
+bool SipFramer::scan_headers() {
+    auto base = _buffer.get();
+    while (_scan < _write) {
+        auto end = static_cast<const char *>(memchr(base + _scan, '\n', _write - _scan));
+        if (end == nullptr) {
+            break;
+        }
+        auto line_end = static_cast<size_t>(end - base);
+        auto line = base + _scan;
+        auto size = line_end - _scan;
+        if (size && line[size - 1] == '\r') {
+            --size;
+        }
+        _scan = line_end + 1;
+        // 空行, 头域结束
+        if (size == 0) {
+            _body = _scan;
+            _state = State::body;
+            return true;
+        }
+        size_t value_pos = 0;
+        if (is_header(line, size, "content-length", value_pos) || is_header(line, size, "l", value_pos)) {
+            _content_length = 0;
+            for (auto pos = value_pos; pos < size; ++pos) {
+                auto ch = static_cast<unsigned char>(line[pos]);
+                if (std::isdigit(ch)) {
+                    // 饱和累加, 超长的数字不会溢出回绕成一个较小的长度
+                    _content_length = (std::min)(_content_length * 10 + (ch - '0'), kMaxDiscardSize + 1);
+                } else if (!std::isblank(ch)) {
+                    break;
+                }
+            }
+        }
+    }
+    if (_write - _read > _max_message_size) {
+        // 头域过长, 丢弃当前消息
+        _read = _write;
+        reset_state();
+    }
+    return false;
+}
+
+bool SipFramer::parse_datagram(const char *data, size_t size, Frame &frame) {
+    size_t pos = 0;
+    while (pos < size) {
+        auto end = static_cast<const char *>(memchr(data + pos, '\n', size - pos));
+        if (end == nullptr) {
+            return false;
+        }
+        auto line_size = static_cast<size_t>(end - data) - pos;
+        if (line_size && data[pos + line_size - 1] == '\r') {
+            --line_size;
+        }
+        if (line_size) {
+            if (auto type = check_start_line(data + pos, line_size); type != MessageType::unknown) {
+                frame.data = data + pos;
+                frame.size = size - pos;
+                frame.type = type;
+                return true;
+            }
+        }
+        pos = static_cast<size_t>(end - data) + 1;
+    }
+    return false;
+}
+
+bool SipFramer::next(Frame &frame) {
+    if (_error) {
+        return false;
+    }
+    while (true) {
+        switch (_state) {
+            case State::start_line:
+                if (!scan_start_line()) {
+                    return false;
+                }
+                break;
+            case State::headers:
+                if (!scan_headers()) {
+                    return false;
+                }
+                if (_body - _read + _content_length > _max_message_size) {
+                    if (_content_length > kMaxDiscardSize) {
+                        _error = true;
+                        return false;
+                    }
+                    // 消息过长, 丢弃已接收部分并记录未接收的消息体长度, 跳过整个消息后重新查找起始行
+                    auto end = _body + _content_length;
+                    _discard = end > _write ? end - _write : 0;
+                    _read = (std::min)(_write, end);
+                    reset_state();
+                }
+                break;
+            case State::body: {
+                if (_write - _body < _content_length) {
+                    return false;
+                }
+                frame.data = _buffer.get() + _read;
+                frame.size = _body + _content_length - _read;
+                frame.type = _type;
+                _read = _body + _content_length;
+                reset_state();
+                return true;
+            }
+        }
+    }
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_framer.cpp
+创建时间:   26-10-17 上午10:12
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 上午10:12
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 上午10:12       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,127 @@
+#ifndef gb28181_src_inner_SIP_FRAMER_H
+#define gb28181_src_inner_SIP_FRAMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace gb28181 {
+
+/**
+ * sip 流式分帧器
+ * 接收缓冲区为一块连续内存，读位置随消息消费前移，只有在尾部空间不足时才整体前移未消费的数据；
+ * 分帧过程记录扫描位置，起始行与 Content-Length 对每个消息只查找一次，
+ * 完整的消息直接以指针 + 长度的形式交给解析器，不再拷贝
+ */
+class SipFramer {
+public:
+    enum class MessageType : uint8_t {
+        unknown = 0,
+        request, // 请求
+        response // 应答
+    };
+
+    struct Frame {
+        const char *data { nullptr };
+        size_t size { 0 };
+        MessageType type { MessageType::unknown };
+    };
+
+    /**
+     * @param max_message_size 单个消息最大长度, 超出的消息将被丢弃
+     */
+    explicit SipFramer(size_t max_message_size = 256 * 1024);
+
+    /**
+     * 追加接收到的数据
+     */
+    void input(const char *data, size_t size);
+
+    /**
+     * 取出下一个完整的消息
+     * @param frame 消息所在内存, 在下一次调用 input 之前有效
+     * @return 没有完整消息时返回 false
+     */
+    bool next(Frame &frame);
+
+    /**
+     * 当前缓存的未消费数据长度
+     */
+    size_t buffered() const { return _write - _read; }
+
+    /**
+     * 消息声明的长度过大, 无法通过跳过消息体恢复分帧, 应关闭连接
+     */
+    bool error() const { return _error; }
+
+    void clear();
+
+    /**
+     * 判断一行是否为 sip 起始行
+     * @param line 不包含行尾的 \r\n
+     */
+    static MessageType check_start_line(const char *line, size_t size);
+
+    /**
+     * udp 数据报总是包含一个完整的消息, 跳过起始行之前的无效数据后, 剩余部分即为消息
+     * 数据报中缺省 Content-Length 时, 消息体一直延续到数据报结尾, 交由解析器处理
+     */
+    static bool parse_datagram(const char *data, size_t size, Frame &frame);
+
+    /**
+     * 判断一行是否为指定头域, 头域名称不区分大小写
+     * @param name 小写的头域名称
+     * @param value_pos 头域值在行内的起始位置
+     */
+    static bool is_header(const char *line, size_t size, std::string_view name, size_t &value_pos);
+
+private:
+    enum class State : uint8_t {
+        start_line, // 查找起始行
+        headers, // 查找头域结束位置
+        body // 等待消息体
+    };
+
+    void reserve(size_t size);
+    void reset_state();
+    bool scan_start_line();
+    bool scan_headers();
+
+private:
+    State _state { State::start_line };
+    MessageType _type { MessageType::unknown };
+    size_t _max_message_size;
+    std::unique_ptr<char[]> _buffer;
+    size_t _capacity { 0 };
+    // 未消费数据起始位置
+    size_t _read { 0 };
+    // 已写入数据结束位置
+    size_t _write { 0 };
+    // 下一次扫描开始位置
+    size_t _scan { 0 };
+    // 消息体起始位置
+    size_t _body { 0 };
+    size_t _content_length { 0 };
+    // 超长消息尚未接收的消息体长度, 后续输入的数据先跳过这部分, 避免把消息体当作新的消息分帧
+    size_t _discard { 0 };
+    bool _error { false };
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_FRAMER_H
+
+/**********************************************************************************************************
+文件名称:   sip_framer.h
+创建时间:   26-10-17 上午10:12
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 上午10:12
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 上午10:12       描述:   创建文件
+
+**********************************************************************************************************/
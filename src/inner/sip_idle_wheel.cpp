@@ -0,0 +1,85 @@
+#include <Poller/EventPoller.h>
+
+#include "sip_idle_wheel.h"
+#include "sip_session.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+// 槽位数量与每个 tick 的时长, 超过一圈的条目在到期前会被重新放入
+static constexpr size_t kSlotCount = 64;
+static constexpr uint64_t kTickMS = 1000;
+
+SipIdleWheel &SipIdleWheel::Instance() {
+    static thread_local SipIdleWheel instance;
+    return instance;
+}
+
+void SipIdleWheel::add(const std::shared_ptr<SipSession> &session, uint64_t timeout_ms) {
+    if (!_started) {
+        _started = true;
+        _slots.resize(kSlotCount);
+        // 时间轮与线程同生命周期, 定时任务不会在时间轮销毁后执行
+        EventPoller::getCurrentPoller()->doDelayTask(kTickMS, [this]() -> uint64_t {
+            on_tick();
+            return kTickMS;
+        });
+    }
+    session->_idle_timeout_ms = timeout_ms;
+    insert(session, timeout_ms);
+}
+
+void SipIdleWheel::insert(const std::weak_ptr<SipSession> &session, uint64_t delay_ms) {
+    // 向上取整, 保证不早于超时时间检查
+    auto deadline = _tick + (std::max)(static_cast<uint64_t>(1), (delay_ms + kTickMS - 1) / kTickMS);
+    _slots[deadline % kSlotCount].push_back({ session, deadline });
+    ++_size;
+}
+
+void SipIdleWheel::on_tick() {
+    ++_tick;
+    auto &slot = _slots[_tick % kSlotCount];
+    if (slot.empty()) {
+        return;
+    }
+    // 先交换出来, 处理过程中重新放入的条目可能落在同一个槽位
+    std::vector<Entry> entries;
+    entries.swap(slot);
+    _size -= entries.size();
+    for (auto &entry : entries) {
+        if (entry.deadline > _tick) {
+            // 还未转到, 留在本槽位
+            slot.push_back(std::move(entry));
+            ++_size;
+            continue;
+        }
+        auto session = entry.session.lock();
+        if (!session || session->_idle_timeout_ms == 0) {
+            continue;
+        }
+        auto elapsed = session->elapsed_time();
+        if (elapsed >= session->_idle_timeout_ms) {
+            // 空闲关闭属于本端主动关闭, 连接池不会为其保持热备
+            session->shutdown(SockException(Err_shutdown, "session timeout"));
+            continue;
+        }
+        insert(entry.session, session->_idle_timeout_ms - elapsed);
+    }
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_idle_wheel.cpp
+创建时间:   26-10-17 下午5:30
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午5:30
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午5:30       描述:   创建文件
+
+**********************************************************************************************************/
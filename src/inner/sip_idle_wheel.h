@@ -0,0 +1,67 @@
+#ifndef gb28181_src_inner_SIP_IDLE_WHEEL_H
+#define gb28181_src_inner_SIP_IDLE_WHEEL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gb28181 {
+class SipSession;
+
+/**
+ * session 空闲检测时间轮
+ * 每个 poller 线程独享一个时间轮, 槽位按秒推进; 收发数据时只更新 session 的活跃时间, 不移动时间轮中的条目,
+ * 到期槽位中的 session 若期间有活动则按剩余时间重新放入对应槽位, 否则超时关闭;
+ * 每个 tick 只处理当前槽位, 与 session 总数无关
+ */
+class SipIdleWheel {
+public:
+    /**
+     * 获取当前线程的时间轮, 必须在 poller 线程内调用
+     */
+    static SipIdleWheel &Instance();
+
+    /**
+     * 加入空闲检测
+     * @param timeout_ms 空闲超时时间
+     */
+    void add(const std::shared_ptr<SipSession> &session, uint64_t timeout_ms);
+
+    /**
+     * 当前线程时间轮中的 session 数量
+     */
+    size_t size() const { return _size; }
+
+private:
+    SipIdleWheel() = default;
+    void insert(const std::weak_ptr<SipSession> &session, uint64_t delay_ms);
+    void on_tick();
+
+private:
+    struct Entry {
+        std::weak_ptr<SipSession> session;
+        uint64_t deadline { 0 }; // 到期的 tick
+    };
+    std::vector<std::vector<Entry>> _slots;
+    uint64_t _tick { 0 };
+    size_t _size { 0 };
+    bool _started { false };
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_IDLE_WHEEL_H
+
+/**********************************************************************************************************
+文件名称:   sip_idle_wheel.h
+创建时间:   26-10-17 下午5:30
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午5:30
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午5:30       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <Poller/Timer.h>
+#include <Thread/WorkThreadPool.h>
+#include <Util/logger.h>
+#include <Util/util.h>
+
+#include "sip_keepalive_sweeper.h"
+#include "subordinate_platform_impl.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+// 槽位数量与每个 tick 的时长, 超过一圈的条目在到期前会被重新放入
+static constexpr size_t kSlotCount = 64;
+static constexpr uint64_t kTickMS = 1000;
+
+void SipKeepaliveSweeper::start() {
+    std::lock_guard<std::mutex> lck(_mtx);
+    if (_timer) {
+        return;
+    }
+    if (_slots.empty()) {
+        _slots.resize(kSlotCount);
+    }
+    // 在后台线程推进, 不占用网络线程
+    _timer = std::make_shared<Timer>(
+        kTickMS / 1000.0f,
+        [weak_this = weak_from_this()]() {
+            if (auto this_ptr = weak_this.lock()) {
+                this_ptr->on_tick();
+                return true;
+            }
+            return false;
+        },
+        WorkThreadPool::Instance().getPoller());
+}
+
+void SipKeepaliveSweeper::stop() {
+    std::shared_ptr<Timer> timer;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        timer.swap(_timer);
+    }
+    timer.reset();
+}
+
+void SipKeepaliveSweeper::add(const std::shared_ptr<SubordinatePlatformImpl> &platform) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _pending.emplace_back(platform);
+    _watched.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SipKeepaliveSweeper::remove(const SubordinatePlatformImpl *platform) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    // 尚未加入时间轮的直接删除, 之后再加入的同地址平台不受影响
+    auto it = std::find_if(_pending.begin(), _pending.end(),
+                           [platform](const std::weak_ptr<SubordinatePlatformImpl> &weak) {
+                               return weak.lock().get() == platform;
+                           });
+    if (it != _pending.end()) {
+        _pending.erase(it);
+        _watched.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+    _removed.emplace_back(platform);
+}
+
+void SipKeepaliveSweeper::drop_removed(std::vector<const SubordinatePlatformImpl *> &removed) {
+    std::sort(removed.begin(), removed.end());
+    for (auto &slot : _slots) {
+        auto it = std::remove_if(slot.begin(), slot.end(), [&](const Entry &entry) {
+            auto platform = entry.platform.lock();
+            return platform && std::binary_search(removed.begin(), removed.end(), platform.get());
+        });
+        _watched.fetch_sub(static_cast<uint64_t>(slot.end() - it), std::memory_order_relaxed);
+        slot.erase(it, slot.end());
+    }
+}
+
+void SipKeepaliveSweeper::insert(Entry &&entry, uint64_t delay_ms) {
+    // 向上取整, 保证不早于超时时间检查
+    entry.deadline = _tick + (std::max)(static_cast<uint64_t>(1), (delay_ms + kTickMS - 1) / kTickMS);
+    auto &slot = _slots[entry.deadline % kSlotCount];
+    slot.emplace_back(std::move(entry));
+}
+
+void SipKeepaliveSweeper::on_tick() {
+    ++_tick;
+    auto now_us = getCurrentMicrosecond(true);
+    std::vector<std::weak_ptr<SubordinatePlatformImpl>> pending;
+    std::vector<const SubordinatePlatformImpl *> removed;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        pending.swap(_pending);
+        removed.swap(_removed);
+    }
+    // 时间轮中只有本次移除之前加入的条目, 先删除再放入新加入的平台
+    if (!removed.empty()) {
+        drop_removed(removed);
+    }
+    std::vector<std::shared_ptr<SubordinatePlatformImpl>> expired;
+    auto check = [&](Entry &&entry) {
+        auto platform = entry.platform.lock();
+        int64_t remain_ms = platform ? platform->keepalive_remain(now_us) : -1;
+        if (remain_ms > 0) {
+            insert(std::move(entry), static_cast<uint64_t>(remain_ms));
+            return;
+        }
+        _watched.fetch_sub(1, std::memory_order_relaxed);
+        if (remain_ms == 0) {
+            expired.emplace_back(std::move(platform));
+        }
+    };
+    for (auto &platform : pending) {
+        check(Entry { std::move(platform), 0 });
+    }
+
+    auto &slot = _slots[_tick % kSlotCount];
+    if (!slot.empty()) {
+        // 先交换出来, 处理过程中重新放入的条目可能落在同一个槽位
+        std::vector<Entry> entries;
+        entries.swap(slot);
+        for (auto &entry : entries) {
+            if (entry.deadline > _tick) {
+                // 还未转到, 留在本槽位
+                slot.emplace_back(std::move(entry));
+                continue;
+            }
+            check(std::move(entry));
+        }
+    }
+    if (expired.empty()) {
+        return;
+    }
+    // 本轮超时的平台投递到各自的 poller 确认后下线, 状态回调与广播不在检测线程执行
+    InfoL << "keepalive expired, platforms: " << expired.size();
+    for (auto &platform : expired) {
+        platform->get_poller()->async(
+            [weak_this = weak_from_this(), platform]() {
+                if (!platform->on_keepalive_timeout()) {
+                    return;
+                }
+                if (auto this_ptr = weak_this.lock()) {
+                    this_ptr->_timeout.fetch_add(1, std::memory_order_relaxed);
+                }
+            },
+            false);
+    }
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_keepalive_sweeper.cpp
+创建时间:   26-10-17 下午11:58
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:58
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:58       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,85 @@
+#ifndef gb28181_src_inner_SIP_KEEPALIVE_SWEEPER_H
+#define gb28181_src_inner_SIP_KEEPALIVE_SWEEPER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace toolkit {
+class Timer;
+}
+
+namespace gb28181 {
+class SubordinatePlatformImpl;
+
+/**
+ * 下级平台心跳超时检测
+ * 所有在线的下级平台共用一个按秒推进的时间轮, 条目的到期时间为平台最后一次注册或心跳加上超时时间;
+ * 收到心跳时只更新平台的心跳时间, 不移动时间轮中的条目, 到期条目若期间有心跳则按剩余时间重新放入;
+ * 每个 tick 只处理当前槽位, 本轮超时的平台在检测结束后投递到各自的 poller 确认并下线
+ */
+class SipKeepaliveSweeper : public std::enable_shared_from_this<SipKeepaliveSweeper> {
+public:
+    /**
+     * 开始检测, 在后台线程每秒推进一次
+     */
+    void start();
+    void stop();
+
+    /**
+     * 加入检测, 可在任意线程调用; 由平台保证同一时间只加入一次
+     */
+    void add(const std::shared_ptr<SubordinatePlatformImpl> &platform);
+    /**
+     * 移除检测, 平台关闭时调用, 可在任意线程调用; 条目在下一个 tick 删除
+     */
+    void remove(const SubordinatePlatformImpl *platform);
+
+    /**
+     * 检测中的平台数
+     */
+    uint64_t size() const { return _watched.load(std::memory_order_relaxed); }
+    /**
+     * 因心跳超时下线的平台数
+     */
+    uint64_t timeout_count() const { return _timeout.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        std::weak_ptr<SubordinatePlatformImpl> platform;
+        uint64_t deadline { 0 }; // 到期的 tick
+    };
+    void insert(Entry &&entry, uint64_t delay_ms);
+    void on_tick();
+    void drop_removed(std::vector<const SubordinatePlatformImpl *> &removed);
+
+private:
+    std::mutex _mtx;
+    std::vector<std::weak_ptr<SubordinatePlatformImpl>> _pending; // 待加入时间轮的平台
+    std::vector<const SubordinatePlatformImpl *> _removed; // 待从时间轮删除的平台
+    std::vector<std::vector<Entry>> _slots;
+    uint64_t _tick { 0 };
+    std::shared_ptr<toolkit::Timer> _timer;
+    std::atomic<uint64_t> _watched { 0 };
+    std::atomic<uint64_t> _timeout { 0 };
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_KEEPALIVE_SWEEPER_H
+
+/**********************************************************************************************************
+文件名称:   sip_keepalive_sweeper.h
+创建时间:   26-10-17 下午11:58
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:58
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:58       描述:   创建文件
+
+**********************************************************************************************************/
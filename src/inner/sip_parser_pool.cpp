@@ -0,0 +1,74 @@
+#include "sip_parser_pool.h"
+
+namespace gb28181 {
+
+// 单个线程每种模式最多缓存的解析器数量
+static constexpr size_t kMaxPoolSize = 256;
+
+std::atomic<uint64_t> SipParserPool::s_hit { 0 };
+std::atomic<uint64_t> SipParserPool::s_miss { 0 };
+
+SipParserPool &SipParserPool::Instance() {
+    static thread_local SipParserPool instance;
+    return instance;
+}
+
+SipParserPool::~SipParserPool() {
+    for (auto &list : _free) {
+        for (auto parser : list) {
+            http_parser_destroy(parser);
+        }
+        list.clear();
+    }
+}
+
+std::shared_ptr<http_parser_t> SipParserPool::obtain(HTTP_PARSER_MODE mode) {
+    http_parser_t *parser = nullptr;
+    auto &list = _free[mode == HTTP_PARSER_REQUEST ? HTTP_PARSER_REQUEST : HTTP_PARSER_RESPONSE];
+    if (!list.empty()) {
+        parser = list.back();
+        list.pop_back();
+        s_hit.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        parser = http_parser_create(mode, nullptr, nullptr);
+        if (parser == nullptr) {
+            return nullptr;
+        }
+        s_miss.fetch_add(1, std::memory_order_relaxed);
+    }
+    return std::shared_ptr<http_parser_t>(parser, [pool = this, mode](http_parser_t *parser) {
+        // 只有在所属线程才能放回对象池
+        auto &current = Instance();
+        if (&current == pool) {
+            current.recycle(parser, mode);
+        } else {
+            http_parser_destroy(parser);
+        }
+    });
+}
+
+void SipParserPool::recycle(http_parser_t *parser, HTTP_PARSER_MODE mode) {
+    auto &list = _free[mode == HTTP_PARSER_REQUEST ? HTTP_PARSER_REQUEST : HTTP_PARSER_RESPONSE];
+    if (list.size() >= kMaxPoolSize) {
+        http_parser_destroy(parser);
+        return;
+    }
+    http_parser_clear(parser);
+    list.emplace_back(parser);
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_parser_pool.cpp
+创建时间:   26-10-17 上午11:20
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 上午11:20
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 上午11:20       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,64 @@
+#ifndef gb28181_src_inner_SIP_PARSER_POOL_H
+#define gb28181_src_inner_SIP_PARSER_POOL_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "http-parser.h"
+
+namespace gb28181 {
+
+/**
+ * http_parser_t 对象池
+ * 每个 poller 线程独享一个对象池, 获取与回收均在所属线程完成, 无需加锁;
+ * 在其他线程释放的对象直接销毁
+ */
+class SipParserPool {
+public:
+    ~SipParserPool();
+
+    /**
+     * 获取当前线程的对象池
+     */
+    static SipParserPool &Instance();
+
+    /**
+     * 获取一个已重置的解析器, 引用计数归零后自动回收
+     */
+    std::shared_ptr<http_parser_t> obtain(HTTP_PARSER_MODE mode);
+
+    /**
+     * 所有线程累计的命中与未命中次数
+     */
+    static uint64_t hit_count() { return s_hit.load(std::memory_order_relaxed); }
+    static uint64_t miss_count() { return s_miss.load(std::memory_order_relaxed); }
+
+private:
+    SipParserPool() = default;
+    void recycle(http_parser_t *parser, HTTP_PARSER_MODE mode);
+
+private:
+    // 下标为 HTTP_PARSER_MODE
+    std::vector<http_parser_t *> _free[2];
+
+    static std::atomic<uint64_t> s_hit;
+    static std::atomic<uint64_t> s_miss;
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_PARSER_POOL_H
+
+/**********************************************************************************************************
+文件名称:   sip_parser_pool.h
+创建时间:   26-10-17 上午11:20
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 上午11:20
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 上午11:20       描述:   创建文件
+
+**********************************************************************************************************/
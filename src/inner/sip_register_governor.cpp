@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "sip_register_governor.h"
+
+namespace gb28181 {
+
+static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void SipRegisterGovernor::set_rate(uint32_t rate, uint32_t max_retry_after) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _rate = rate;
+    _max_retry_after = (std::max)(max_retry_after, 1u);
+    _tokens = rate;
+    _last_us = now_us();
+    _next_slot_us = 0;
+}
+
+bool SipRegisterGovernor::admit(uint32_t &retry_after) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    if (!_rate) {
+        _admitted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    auto now = now_us();
+    // 令牌桶容量为一秒的配额
+    _tokens = (std::min)(static_cast<double>(_rate), _tokens + (now - _last_us) * _rate / 1000000.0);
+    _last_us = now;
+    if (_tokens >= 1) {
+        _tokens -= 1;
+        _admitted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 按速率分配重试时间槽, 使被推迟的设备依次返回
+    auto interval = static_cast<uint64_t>(1000000 / _rate);
+    auto slot = (std::max)(_next_slot_us, now + interval);
+    auto max_delay = _max_retry_after * 1000000ull;
+    uint64_t delay = slot - now;
+    if (delay <= max_delay) {
+        _next_slot_us = slot + interval;
+    } else {
+        // 虚拟队列已满, 不再占用时间槽, 以上限时间重试
+        delay = max_delay;
+    }
+    // ±20% 随机抖动, 避免同一时间槽附近的设备再次同时到达
+    auto jitter = 0.8 + 0.4 * std::uniform_real_distribution<double>(0, 1)(_rand);
+    retry_after = static_cast<uint32_t>((std::max)(1.0, std::ceil(delay * jitter / 1000000.0)));
+    _deferred.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+uint64_t SipRegisterGovernor::queue_length() const {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto now = now_us();
+    if (!_rate || _next_slot_us <= now) {
+        return 0;
+    }
+    return (_next_slot_us - now) * _rate / 1000000;
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_register_governor.cpp
+创建时间:   26-10-17 下午11:20
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:20
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:20       描述:   创建文件
+
+**********************************************************************************************************/
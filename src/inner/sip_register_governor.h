@@ -0,0 +1,66 @@
+#ifndef gb28181_src_inner_SIP_REGISTER_GOVERNOR_H
+#define gb28181_src_inner_SIP_REGISTER_GOVERNOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+namespace gb28181 {
+
+/**
+ * 注册风暴控制
+ * 全局令牌桶限制每秒转为在线的下级平台数; 超出速率的注册回复 503, 并为其分配虚拟队列中的重试时间槽,
+ * 重试时间按速率依次错开并叠加随机抖动, 使大量设备的重新注册平滑地分摊到后续时间内
+ */
+class SipRegisterGovernor {
+public:
+    /**
+     * @param rate 每秒允许的新注册数, 为 0 时不限制
+     * @param max_retry_after Retry-After 上限(秒)
+     */
+    void set_rate(uint32_t rate, uint32_t max_retry_after);
+
+    /**
+     * 判断注册是否立即接受
+     * @param retry_after 被推迟时建议设备重试的间隔(秒)
+     * @return 超出速率时返回 false
+     */
+    bool admit(uint32_t &retry_after);
+
+    uint64_t admitted_count() const { return _admitted.load(std::memory_order_relaxed); }
+    uint64_t deferred_count() const { return _deferred.load(std::memory_order_relaxed); }
+    /**
+     * 已推迟、预计尚未重试的注册数
+     */
+    uint64_t queue_length() const;
+
+private:
+    mutable std::mutex _mtx;
+    uint32_t _rate { 0 };
+    uint32_t _max_retry_after { 120 };
+    double _tokens { 0 };
+    uint64_t _last_us { 0 };
+    uint64_t _next_slot_us { 0 }; // 虚拟队列中下一个可分配的重试时间
+    std::minstd_rand _rand { std::random_device {}() };
+    std::atomic<uint64_t> _admitted { 0 };
+    std::atomic<uint64_t> _deferred { 0 };
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_REGISTER_GOVERNOR_H
+
+/**********************************************************************************************************
+文件名称:   sip_register_governor.h
+创建时间:   26-10-17 下午11:20
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:20
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:20       描述:   创建文件
+
+**********************************************************************************************************/
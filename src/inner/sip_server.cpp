@@ -4,11 +4,19 @@
 #include <sip-message.h>
 #include <sip-subscribe.h>
 #include "uas/sip-uas-transaction.h"
+#include <Poller/Timer.h>
 #include <Thread/WorkThreadPool.h>
 #include <Util/NoticeCenter.h>
 
 #include "inner/sip_session.h"
+#include "dns_cache.h"
+#include "platform_snapshot.h"
 #include "sip_common.h"
+#include "sip_capture.h"
+#include "sip_egress.h"
+#include "sip_parser_pool.h"
+#include "sip_tcp_pool.h"
+#include "sip_udp_listener.h"
 
 #include "super_platform_impl.h"
 #include "subordinate_platform_impl.h"
@@ -41,6 +49,9 @@ SipServer::SipServer(local_account account)
     if (account_.host.empty()) {
         account_.host = "::";
     }
+    admission_.set_rate(account_.admission_register_rate, account_.admission_message_rate, account_.admission_burst);
+    register_governor_.set_rate(account_.register_governor_rate, account_.register_governor_max_retry);
+    super_scheduler_->set_config(account_.super_schedule_jitter, account_.super_register_concurrency);
     // 一般来说，建议配置本地IP
     if (account_.local_host.empty()) {
         if (!is_loopback_ip(account_.host.c_str())) {
@@ -79,67 +90,111 @@ std::shared_ptr<LocalServer> LocalServer::new_local_server(local_account account
     return std::make_shared<SipServer>(std::move(account));
 }
 
-std::shared_ptr<SubordinatePlatform> SipServer::get_subordinate_platform(const std::string &platform_id) {
-    std::shared_lock<decltype(platform_mutex_)> lock(platform_mutex_);
-    if (auto it = sub_platforms_.find(platform_id); it != sub_platforms_.end()) {
-        return it->second;
+// 在调用线程依次创建平台对象, 再按分片批量加入平台表;
+// 平台构造会绑定 poller 与 UDP 对端、读取服务账号, 没有按多线程设计, 不放到线程池并行创建
+template <typename Impl, typename Account>
+static std::vector<std::shared_ptr<Impl>> add_platforms(
+    const std::shared_ptr<SipServer> &server, PlatformRegistry<Impl> &registry, std::vector<Account> &&accounts) {
+    std::vector<std::shared_ptr<Impl>> platforms(accounts.size());
+    std::vector<DeviceCode> codes(accounts.size());
+    for (size_t i = 0; i < accounts.size(); ++i) {
+        // 不是 20 位数字的编码保持无效值, 之后按字符串加入
+        if (!DeviceCode::parse(accounts[i].platform_id, codes[i])) {
+            codes[i] = DeviceCode();
+        }
+        platforms[i] = std::make_shared<Impl>(std::move(accounts[i]), server);
     }
-    return nullptr;
-}
-std::vector<std::shared_ptr<SubordinatePlatform>> SipServer::get_all_subordinate_platform() {
-    std::vector<std::shared_ptr<SubordinatePlatform>> platforms;
-    {
-        std::shared_lock<decltype(platform_mutex_)> lock(platform_mutex_);
-        for (auto &it : sub_platforms_) {
-            platforms.emplace_back(it.second);
+    // 同一批次中编码重复时只保留最后一个
+    std::unordered_map<DeviceCode, size_t, DeviceCode::Hash> last;
+    std::unordered_map<std::string, size_t> others;
+    last.reserve(platforms.size());
+    for (size_t i = 0; i < platforms.size(); ++i) {
+        auto &index = codes[i].valid() ? last.emplace(codes[i], i).first->second
+                                       : others.emplace(platforms[i]->account().platform_id, i).first->second;
+        if (index != i) {
+            platforms[index].reset();
+            index = i;
         }
     }
+    std::vector<std::pair<DeviceCode, std::shared_ptr<Impl>>> items;
+    items.reserve(last.size());
+    for (auto &it : last) {
+        items.emplace_back(it.first, platforms[it.second]);
+    }
+    auto replaced = registry.assign(std::move(items));
+    for (auto &it : others) {
+        if (auto old = registry.assign(it.first, platforms[it.second])) {
+            replaced.emplace_back(std::move(old));
+        }
+    }
+    for (auto &old : replaced) {
+        old->shutdown();
+    }
     return platforms;
 }
+
+std::shared_ptr<SubordinatePlatform> SipServer::get_subordinate_platform(const std::string &platform_id) {
+    return sub_platforms_.find(platform_id);
+}
+std::vector<std::shared_ptr<SubordinatePlatform>> SipServer::get_all_subordinate_platform() {
+    return sub_platforms_.all<SubordinatePlatform>();
+}
 std::shared_ptr<SuperPlatform> SipServer::get_super_platform(const std::string &platform_id) {
-    std::shared_lock<decltype(platform_mutex_)> lock(platform_mutex_);
-    if (auto it = super_platforms_.find(platform_id); it != super_platforms_.end()) {
-        return it->second;
-    }
-    return nullptr;
+    return super_platforms_.find(platform_id);
 }
 std::vector<std::shared_ptr<SuperPlatform>> SipServer::get_all_super_platforms() {
-    std::vector<std::shared_ptr<SuperPlatform>> platforms;
-    {
-        std::shared_lock<decltype(platform_mutex_)> lock(platform_mutex_);
-        for (auto &it : super_platforms_) {
-            platforms.emplace_back(it.second);
-        }
-    }
-    return platforms;
+    return super_platforms_.all<SuperPlatform>();
 }
 std::shared_ptr<SubordinatePlatform> SipServer::add_subordinate_platform(subordinate_account &&account) {
-    std::string platform_id = account.platform_id;
-    std::shared_lock<decltype(platform_mutex_)> lock(platform_mutex_);
     auto platform = std::make_shared<SubordinatePlatformImpl>(std::move(account), shared_from_this());
-    sub_platforms_[platform_id] = platform;
+    // 被替换的旧平台在锁外关闭
+    if (auto old = sub_platforms_.assign(platform->account().platform_id, platform)) {
+        old->shutdown();
+    }
+    restore_snapshot(platform);
     return platform;
 }
 void SipServer::remove_subordinate_platform(const std::string &platform_id) {
-    std::shared_lock<decltype(platform_mutex_)> lock(platform_mutex_);
-    if (auto it = sub_platforms_.find(platform_id); it != sub_platforms_.end()) {
-        it->second->shutdown();
-        sub_platforms_.erase(it);
+    if (auto platform = sub_platforms_.remove(platform_id)) {
+        platform->shutdown();
+    }
+    // 尚未添加回来的平台在快照中仍保留槽位, 需要显式移除
+    DeviceCode code;
+    std::lock_guard<std::mutex> lck(snapshot_mtx_);
+    if (snapshot_ && DeviceCode::parse(platform_id, code)) {
+        snapshot_->remove(code);
     }
 }
 std::shared_ptr<SuperPlatform> SipServer::add_super_platform(super_account &&account) {
-    std::string platform_id = account.platform_id;
-    std::shared_lock<decltype(platform_mutex_)> lock(platform_mutex_);
     auto platform = std::make_shared<SuperPlatformImpl>(std::move(account), shared_from_this());
-    super_platforms_[platform_id] = platform;
+    if (auto old = super_platforms_.assign(platform->account().platform_id, platform)) {
+        old->shutdown();
+    }
     platform->start();
     return platform;
 }
+std::vector<std::shared_ptr<SubordinatePlatform>>
+SipServer::add_subordinate_platforms(std::vector<subordinate_account> &&accounts) {
+    auto platforms = add_platforms(shared_from_this(), sub_platforms_, std::move(accounts));
+    for (auto &platform : platforms) {
+        if (platform) {
+            restore_snapshot(platform);
+        }
+    }
+    return { platforms.begin(), platforms.end() };
+}
+std::vector<std::shared_ptr<SuperPlatform>> SipServer::add_super_platforms(std::vector<super_account> &&accounts) {
+    auto platforms = add_platforms(shared_from_this(), super_platforms_, std::move(accounts));
+    for (auto &platform : platforms) {
+        if (platform) {
+            platform->start();
+        }
+    }
+    return { platforms.begin(), platforms.end() };
+}
 void SipServer::remove_super_platform(const std::string &platform_id) {
-    std::shared_lock<decltype(platform_mutex_)> lock(platform_mutex_);
-    if (auto it = super_platforms_.find(platform_id); it != super_platforms_.end()) {
-        it->second->shutdown();
-        super_platforms_.erase(it);
+    if (auto platform = super_platforms_.remove(platform_id)) {
+        platform->shutdown();
     }
 }
 void SipServer::reload_account(sip_account account) {}
@@ -153,17 +208,12 @@ void SipServer::new_subordinate_account(
             if (!allow)
                 return allow_cb(nullptr);
             if (auto this_ptr = weak_this.lock()) {
-                if (auto platform = this_ptr->get_subordinate_platform(account->platform_id)) {
-                    return allow_cb(std::dynamic_pointer_cast<SubordinatePlatformImpl>(platform));
+                if (auto platform = this_ptr->sub_platforms_.find(account->platform_id)) {
+                    return allow_cb(platform);
                 }
-                std::shared_ptr<SubordinatePlatformImpl> platform
-                    = std::make_shared<SubordinatePlatformImpl>(*account, this_ptr);
-                ;
-                {
-                    std::unique_lock<decltype(platform_mutex_)> lock(this_ptr->platform_mutex_);
-                    this_ptr->sub_platforms_[account->platform_id] = platform;
-                }
-                return allow_cb(platform);
+                // 并发注册时以先加入的平台为准
+                return allow_cb(this_ptr->sub_platforms_.insert(
+                    account->platform_id, std::make_shared<SubordinatePlatformImpl>(*account, this_ptr)));
             }
             return allow_cb(nullptr);
         });
@@ -186,6 +236,56 @@ uint32_t SipServer::make_ssrc(bool is_playback) {
            + old_value;
 }
 
+server_statistics SipServer::get_statistics() const {
+    server_statistics statistics;
+    statistics.parser_pool_hit = SipParserPool::hit_count();
+    statistics.parser_pool_miss = SipParserPool::miss_count();
+    SipSession::get_recv_statistics(statistics);
+    SipEgress::get_statistics(statistics);
+    statistics.recv_queued_bytes = (std::max)(recv_queued_bytes_.load(std::memory_order_relaxed), int64_t(0));
+    statistics.recv_queued_messages = (std::max)(recv_queued_messages_.load(std::memory_order_relaxed), int64_t(0));
+    statistics.overload_udp_dropped = overload_udp_dropped_.load(std::memory_order_relaxed);
+    statistics.overload_udp_rejected = overload_udp_rejected_.load(std::memory_order_relaxed);
+    statistics.overload_tcp_paused = overload_tcp_paused_.load(std::memory_order_relaxed);
+    statistics.admission_rejected = admission_.rejected_count();
+    statistics.register_governor_admitted = register_governor_.admitted_count();
+    statistics.register_governor_deferred = register_governor_.deferred_count();
+    statistics.register_governor_queue = register_governor_.queue_length();
+    statistics.keepalive_watched = keepalive_sweeper_->size();
+    statistics.keepalive_timeout = keepalive_sweeper_->timeout_count();
+    super_scheduler_->get_statistics(statistics);
+    return statistics;
+}
+
+void SipServer::add_recv_queued(int64_t bytes, int64_t messages) {
+    if (bytes) {
+        recv_queued_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    if (messages) {
+        recv_queued_messages_.fetch_add(messages, std::memory_order_relaxed);
+    }
+}
+
+bool SipServer::is_recv_overloaded() const {
+    if (account_.server_max_queued_bytes
+        && recv_queued_bytes_.load(std::memory_order_relaxed) > static_cast<int64_t>(account_.server_max_queued_bytes)) {
+        return true;
+    }
+    return account_.server_max_queued_messages
+        && recv_queued_messages_.load(std::memory_order_relaxed)
+        >= static_cast<int64_t>(account_.server_max_queued_messages);
+}
+
+void SipServer::set_capture_enabled(bool enable) {
+    SipCapture::Instance().set_enabled(enable);
+}
+bool SipServer::dump_capture(const std::string &path) {
+    return SipCapture::Instance().dump(path);
+}
+void SipServer::set_capture_trigger(const std::string &platform_id, const std::string &path) {
+    SipCapture::Instance().set_trigger(platform_id, path);
+}
+
 SipServer::~SipServer() = default;
 
 void SipServer::run() {
@@ -195,7 +295,21 @@ void SipServer::run() {
     }
     auto poller = EventPollerPool::Instance().getPoller();
     auto weak_this = weak_from_this();
-    if (account_.transport_type == TransportType::both || account_.transport_type == TransportType::udp) {
+    if (account_.udp_reuse_port
+        && (account_.transport_type == TransportType::both || account_.transport_type == TransportType::udp)) {
+        // 每个 poller 独立绑定同一端口, 由内核分发数据报, 避免单个监听 socket 成为瓶颈
+        EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+            auto poller = std::static_pointer_cast<EventPoller>(executor);
+            auto listener = std::make_shared<SipUdpListener>(poller, shared_from_this());
+            if (listener->start(account_.port, account_.host)) {
+                udp_server_sip_socket_[poller.get()] = listener->socket();
+                udp_listeners_.emplace_back(std::move(listener));
+            }
+        });
+        if (udp_listeners_.empty()) {
+            throw std::runtime_error("udp listen on " + account_.host + ":" + std::to_string(account_.port) + " failed");
+        }
+    } else if (account_.transport_type == TransportType::both || account_.transport_type == TransportType::udp) {
         udp_server_ = std::make_shared<UdpServer>();
         // 设置socket 创建回调，用来记录所有监听的 socket
         udp_server_->setOnCreateSocket(
@@ -209,36 +323,131 @@ void SipServer::run() {
         // 启动 udp 监听
         udp_server_->start<SipSession>(
             account_.port, account_.host, [weak_this](const std::shared_ptr<SipSession> &session) {
+                auto this_ptr = weak_this.lock();
                 session->_sip_server = weak_this;
-                session->_sip_agent = weak_this.lock()->sip_.get();
+                session->_sip_agent = this_ptr->sip_.get();
+                session->start_idle_check(this_ptr->account_.session_idle_timeout * 1000ull);
             });
         udp_server_->setOnCreateSocket({});
     }
+    // 每个 poller 一个复用监听 socket 的发送 session, 平台只保存目标地址
+    for (auto &it : udp_server_sip_socket_) {
+        auto session = std::make_shared<SipSession>(it.second);
+        // 预先格式化 Via, 之后多个线程只读
+        session->via_local();
+        udp_send_sessions_.emplace(it.first, std::move(session));
+    }
     if (account_.transport_type == TransportType::both || account_.transport_type == TransportType::tcp) {
         tcp_server_ = std::make_shared<TcpServer>();
         tcp_server_->start<SipSession>(
             account_.port, account_.host, 1024, [weak_this](const std::shared_ptr<SipSession> &session) {
+                auto this_ptr = weak_this.lock();
                 session->_sip_server = weak_this;
-                session->_sip_agent = weak_this.lock()->sip_.get();
+                session->_sip_agent = this_ptr->sip_.get();
+                session->start_idle_check(this_ptr->account_.session_idle_timeout * 1000ull);
             });
+        if (account_.tcp_pool_standby) {
+            tcp_pool_ = std::make_shared<SipTcpPool>(
+                account_.host + ":" + std::to_string(account_.port),
+                [weak_this](const struct sockaddr_storage &addr, SipTcpPool::Callback cb) {
+                    if (auto this_ptr = weak_this.lock()) {
+                        this_ptr->get_tcp_client_l(addr, std::move(cb));
+                    } else {
+                        cb(toolkit::SockException(Err_other, "server destruction"), nullptr);
+                    }
+                },
+                account_.tcp_pool_standby * 1000ull);
+            tcp_pool_->start(poller);
+        }
+    }
+    // 所有下级平台共用一个心跳超时检测
+    keepalive_sweeper_->start();
+    // 所有上级平台共用一个注册与心跳调度
+    super_scheduler_->start();
+    if (!account_.snapshot_path.empty()) {
+        auto snapshot = std::make_shared<PlatformSnapshot>(account_.snapshot_path);
+        if (snapshot->open()) {
+            {
+                std::lock_guard<std::mutex> lck(snapshot_mtx_);
+                snapshot_ = std::move(snapshot);
+            }
+            // 运行前已添加的平台在此恢复, 之后添加的平台在添加时恢复
+            for (auto &platform : sub_platforms_.all()) {
+                restore_snapshot(platform);
+            }
+            // 在后台线程定期写入, 不占用网络线程
+            snapshot_timer_ = std::make_shared<Timer>(
+                (std::max)(account_.snapshot_interval, 1u),
+                [weak_this]() {
+                    if (auto this_ptr = weak_this.lock()) {
+                        this_ptr->save_snapshot();
+                        return true;
+                    }
+                    return false;
+                },
+                WorkThreadPool::Instance().getPoller());
+        }
     }
 }
+void SipServer::save_snapshot() {
+    std::lock_guard<std::mutex> lck(snapshot_mtx_);
+    if (!snapshot_) {
+        return;
+    }
+    for (auto &platform : sub_platforms_.all()) {
+        DeviceCode code;
+        if (DeviceCode::parse(platform->account().platform_id, code)) {
+            PlatformSnapshot::State state;
+            platform->get_snapshot_state(state);
+            snapshot_->update(code, state);
+        }
+    }
+    snapshot_->commit();
+}
+void SipServer::restore_snapshot(const std::shared_ptr<SubordinatePlatformImpl> &platform) {
+    DeviceCode code;
+    PlatformSnapshot::State state;
+    {
+        std::lock_guard<std::mutex> lck(snapshot_mtx_);
+        if (!snapshot_ || !DeviceCode::parse(platform->account().platform_id, code) || !snapshot_->take(code, state)) {
+            return;
+        }
+    }
+    platform->restore_snapshot_state(state);
+}
+std::shared_ptr<SipSession> SipServer::udp_send_session(toolkit::EventPoller *poller) const {
+    if (udp_send_sessions_.empty()) {
+        return nullptr;
+    }
+    auto it = udp_send_sessions_.find(poller);
+    return it != udp_send_sessions_.end() ? it->second : udp_send_sessions_.begin()->second;
+}
+
 void SipServer::shutdown() {
     if (running_.exchange(false)) {
-        std::unordered_map<std::string, std::shared_ptr<SuperPlatformImpl>> super_platforms;
-        std::unordered_map<std::string, std::shared_ptr<SubordinatePlatformImpl>> sub_platforms;
+        // 平台移除前写入最后一次快照
+        save_snapshot();
+        snapshot_timer_.reset();
+        keepalive_sweeper_->stop();
+        super_scheduler_->stop();
         {
-            std::unique_lock<decltype(platform_mutex_)> lock(platform_mutex_);
-            super_platforms_.swap(super_platforms);
-            sub_platforms_.swap(sub_platforms);
+            std::lock_guard<std::mutex> lck(snapshot_mtx_);
+            snapshot_.reset();
         }
-        for (const auto &it : super_platforms) {
-            it.second->shutdown();
+        for (const auto &it : super_platforms_.clear()) {
+            it->shutdown();
         }
-        for (const auto &it : sub_platforms) {
-            it.second->shutdown();
+        for (const auto &it : sub_platforms_.clear()) {
+            it->shutdown();
         }
         udp_server_.reset();
+        udp_listeners_.clear();
+        udp_send_sessions_.clear();
+        udp_server_sip_socket_.clear();
+        if (tcp_pool_) {
+            tcp_pool_->clear();
+            tcp_pool_.reset();
+        }
         tcp_server_.reset();
     }
 }
@@ -265,29 +474,34 @@ void SipServer::get_tcp_client(const std::string &host, uint16_t port,
     const std::function<void(const toolkit::SockException &e, std::shared_ptr<SipSession>)> cb) {
     auto poller = EventPollerPool::Instance().getPoller();
 
+    if (toolkit::isIP(host.c_str())) {
+        auto addr = toolkit::SockUtil::make_sockaddr(host.c_str(), port);
+        get_tcp_client_p(addr, cb);
+        return;
+    }
     auto weak_this = weak_from_this();
-    if (!toolkit::isIP(host.c_str())) {
-        WorkThreadPool::Instance().getPoller()->async([poller, host, port, cb, weak_this]() {
-            struct sockaddr_storage addr;
-            if (!SockUtil::getDomainIP(
-                    host.c_str(), port, addr, AF_INET, SOCK_DGRAM, IPPROTO_TCP)) {
-                poller->async(
-                    [cb, host]() { cb(toolkit::SockException(Err_dns, "dns resolution failed" + host), nullptr); });
-                return;
+    DnsCache::Instance().resolve(host, port, [poller, host, cb, weak_this](bool success, const sockaddr_storage &addr) {
+        // 切回原始线程继续处理
+        poller->async([weak_this, success, addr, host, cb]() {
+            if (!success) {
+                cb(toolkit::SockException(Err_dns, "dns resolution failed: " + host), nullptr);
+            } else if (auto this_ptr = weak_this.lock()) {
+                this_ptr->get_tcp_client_p(addr, cb);
+            } else {
+                cb(toolkit::SockException(Err_other, "server destruction"), nullptr);
             }
-            // 切回原始线程继续处理
-            poller->async([weak_this, addr, cb]() {
-                if (auto this_ptr = weak_this.lock()) {
-                    this_ptr->get_tcp_client_l(addr, cb);
-                } else {
-                    cb(toolkit::SockException(Err_other, "server destruction"), nullptr);
-                }
-            });
         });
-    } else {
-        auto addr = toolkit::SockUtil::make_sockaddr(host.c_str(), port);
-        get_tcp_client_l(addr, cb);
+    });
+}
+
+void SipServer::get_tcp_client_p(const struct sockaddr_storage &addr,
+    const std::function<void(const toolkit::SockException &e, std::shared_ptr<SipSession>)> cb) {
+    // 优先复用连接池中的连接
+    if (auto pool = tcp_pool_) {
+        pool->obtain(addr, cb);
+        return;
     }
+    get_tcp_client_l(addr, cb);
 }
 
 #define GetSipSession(s)                                                                                               \
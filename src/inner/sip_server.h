@@ -6,6 +6,12 @@
 #include <functional>
 #include <gb28181/local_server.h>
 #include <memory>
+#include <mutex>
+#include "platform_registry.h"
+#include "sip_admission.h"
+#include "sip_keepalive_sweeper.h"
+#include "sip_super_scheduler.h"
+#include "sip_register_governor.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,11 +23,17 @@ struct sip_dialog_t;
 }
 #endif
 
+namespace toolkit {
+class Timer;
+}
 namespace gb28181 {
 class SuperPlatformImpl;
 class SubordinatePlatformImpl;
 struct sip_agent_param;
 class SipSession;
+class SipUdpListener;
+class SipTcpPool;
+class PlatformSnapshot;
 class SipServer;
 struct sip_agent_param {
     std::shared_ptr<SipSession> session_ptr;
@@ -59,6 +71,10 @@ public:
     void get_tcp_client(const std::string &host, uint16_t port,std::function<void(const toolkit::SockException &e, std::shared_ptr<SipSession>)> cb);
 
     void get_tcp_client_l(const struct sockaddr_storage &addr, std::function<void(const toolkit::SockException &e, std::shared_ptr<SipSession>)> cb);
+    /**
+     * 获取出站 tcp 连接, 启用连接池时复用已有连接, 并合并同时发起的连接请求
+     */
+    void get_tcp_client_p(const struct sockaddr_storage &addr, std::function<void(const toolkit::SockException &e, std::shared_ptr<SipSession>)> cb);
 
     inline std::shared_ptr<sip_agent_t> get_sip_agent() const { return sip_; }
 
@@ -69,6 +85,9 @@ public:
     std::shared_ptr<SubordinatePlatform> add_subordinate_platform(subordinate_account &&account) override;
     void remove_subordinate_platform(const std::string &platform_id) override;
     std::shared_ptr<SuperPlatform> add_super_platform(super_account &&account) override;
+    std::vector<std::shared_ptr<SubordinatePlatform>>
+    add_subordinate_platforms(std::vector<subordinate_account> &&accounts) override;
+    std::vector<std::shared_ptr<SuperPlatform>> add_super_platforms(std::vector<super_account> &&accounts) override;
     void remove_super_platform(const std::string &platform_id) override;
 
     void set_new_subordinate_account_callback(subordinate_account_callback cb) override { new_subordinate_account_callback_ = std::move(cb); }
@@ -76,14 +95,59 @@ public:
 
     uint32_t make_ssrc(bool is_playback) override;
 
+    server_statistics get_statistics() const override;
+
+    /**
+     * 接收队列计数, 由 session 在缓存或处理完成时增减
+     */
+    void add_recv_queued(int64_t bytes, int64_t messages);
+    /**
+     * 服务整体接收队列是否超限
+     */
+    bool is_recv_overloaded() const;
+    /**
+     * 接收准入控制
+     */
+    SipAdmission &admission() { return admission_; }
+    /**
+     * 注册风暴控制
+     */
+    SipRegisterGovernor &register_governor() { return register_governor_; }
+    /**
+     * 下级平台心跳超时检测
+     */
+    SipKeepaliveSweeper &keepalive_sweeper() { return *keepalive_sweeper_; }
+    /**
+     * 上级平台注册与心跳调度
+     */
+    SipSuperScheduler &super_scheduler() { return *super_scheduler_; }
+    void on_udp_dropped() { overload_udp_dropped_.fetch_add(1, std::memory_order_relaxed); }
+    void on_udp_rejected() { overload_udp_rejected_.fetch_add(1, std::memory_order_relaxed); }
+    void on_tcp_paused() { overload_tcp_paused_.fetch_add(1, std::memory_order_relaxed); }
+    void set_capture_enabled(bool enable) override;
+    bool dump_capture(const std::string &path) override;
+    void set_capture_trigger(const std::string &platform_id, const std::string &path) override;
+
     const std::unordered_map<toolkit::EventPoller *, std::shared_ptr<toolkit::Socket>> &udp_server_sockets() const {
         return udp_server_sip_socket_;
     }
+    /**
+     * 获取 poller 对应的 udp 发送 session, 由所有平台共享, 发送时指定目标地址
+     */
+    std::shared_ptr<SipSession> udp_send_session(toolkit::EventPoller *poller) const;
 
 
 
 private:
     void init_agent();
+    /**
+     * 将下级平台状态写入快照
+     */
+    void save_snapshot();
+    /**
+     * 使用快照恢复平台状态
+     */
+    void restore_snapshot(const std::shared_ptr<SubordinatePlatformImpl> &platform);
 
 
     static int onregister(
@@ -122,16 +186,31 @@ private:
 private:
     local_account account_; // 本地账户信息
     std::atomic_bool running_ { false };
+    std::atomic<int64_t> recv_queued_bytes_ { 0 };
+    std::atomic<int64_t> recv_queued_messages_ { 0 };
+    std::atomic<uint64_t> overload_udp_dropped_ { 0 };
+    std::atomic<uint64_t> overload_udp_rejected_ { 0 };
+    std::atomic<uint64_t> overload_tcp_paused_ { 0 };
+    SipAdmission admission_;
+    SipRegisterGovernor register_governor_;
+    std::shared_ptr<SipKeepaliveSweeper> keepalive_sweeper_ { std::make_shared<SipKeepaliveSweeper>() };
+    std::shared_ptr<SipSuperScheduler> super_scheduler_ { std::make_shared<SipSuperScheduler>() };
     uint32_t server_ssrc_domain_ {0};
     std::unordered_map<toolkit::EventPoller *, std::shared_ptr<toolkit::Socket>> udp_server_sip_socket_;
     toolkit::UdpServer::Ptr udp_server_ { nullptr };
+    std::unordered_map<toolkit::EventPoller *, std::shared_ptr<SipSession>> udp_send_sessions_; // 每个 poller 的 udp 发送 session
+    std::shared_ptr<SipTcpPool> tcp_pool_; // 出站 tcp 连接池
+    std::mutex snapshot_mtx_;
+    std::shared_ptr<PlatformSnapshot> snapshot_; // 下级平台状态快照
+    std::shared_ptr<toolkit::Timer> snapshot_timer_;
+    std::vector<std::shared_ptr<SipUdpListener>> udp_listeners_; // udp_reuse_port 模式下每个 poller 的监听
     toolkit::TcpServer::Ptr tcp_server_ { nullptr };
     std::shared_ptr<sip_uas_handler_t> handler_ { nullptr };
     std::shared_ptr<sip_agent_t> sip_ { nullptr };
 
-    std::unordered_map<std::string, std::shared_ptr<SuperPlatformImpl>> super_platforms_; // 上级平台
-    std::unordered_map<std::string, std::shared_ptr<SubordinatePlatformImpl>> sub_platforms_; // 下级平台
-    std::shared_mutex platform_mutex_;
+    // 平台表以 20 位编码为键, 编码不合法的平台不会加入
+    PlatformRegistry<SuperPlatformImpl> super_platforms_; // 上级平台
+    PlatformRegistry<SubordinatePlatformImpl> sub_platforms_; // 下级平台
     subordinate_account_callback new_subordinate_account_callback_; // 查找下级平台?
     friend class SipSession;
 };
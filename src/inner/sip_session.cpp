@@ -1,7 +1,16 @@
 #include "sip_session.h"
 #include "http-parser.h"
 #include "sip_common.h"
-
+#include "sip_egress.h"
+#include "sip_idle_wheel.h"
+#include "sip_parser_pool.h"
+#include "sip_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <Util/ResourcePool.h>
 #include <gb28181/sip_event.h>
 #include <sip-agent.h>
 #include <sip-message.h>
@@ -20,17 +29,27 @@ SipSession::SipSession(const toolkit::Socket::Ptr &sock, bool is_client)
         getpeername(sock->rawFD(), (struct sockaddr *)&_addr, &addr_len);
     }
     _is_udp = sock->sockType() == SockNum::Sock_UDP || sock->sockType() == SockNum::Sock_Invalid;
+    // 客户端 socket 此时尚未连接, 在 onSockConnect 中获取
+    if (sock->rawFD() >= 0) {
+        load_local_addr();
+    }
     if(sock)
      TraceP(this) << "SipSession::SipSession()";
     else TraceL << "SipSession::SipSession()";
 }
 SipSession::~SipSession() {
     TraceP(this) << "SipSession::~SipSession()";
+    // 归还计入服务的接收队列
+    if (_queued_bytes || _queued_messages) {
+        if (auto server = _sip_server.lock()) {
+            server->add_recv_queued(-static_cast<int64_t>(_queued_bytes), -static_cast<int64_t>(_queued_messages));
+        }
+    }
 }
 
 void SipSession::set_peer(const std::string &host, uint16_t port) {
     // tcp 模式下，与 udp session 模式下都不需要设置对端地址
-    if (!is_udp() || !get_peer_ip().empty()) {
+    if (!is_unbound()) {
         return;
     }
     struct sockaddr_storage addr = SockUtil::make_sockaddr(host.c_str(), port);
@@ -38,26 +57,23 @@ void SipSession::set_peer(const std::string &host, uint16_t port) {
 }
 
 bool SipSession::make_peer_addr(struct sockaddr_storage &addr) {
-    // 获取当前 socket
-    auto &socket = getSock();
-    if (!socket) {
-        return false; // 无效的 socket
-    }
-
-    // 获取本地地址
-    struct sockaddr_storage local_addr{};
-    if (!SockUtil::get_sock_local_addr(socket->rawFD(), local_addr)) {
-        ErrorL << "SockUtil::get_sock_local_addr() failed";
-        return false; // 获取本地地址失败
+    // 本地地址族在创建时已缓存
+    if (_local_family == AF_UNSPEC) {
+        load_local_addr();
+        if (_local_family == AF_UNSPEC) {
+            ErrorL << "SockUtil::get_sock_local_addr() failed";
+            return false; // 获取本地地址失败
+        }
     }
+    auto local_family = _local_family;
 
     // 如果本地地址族与传入地址族相同，直接返回 true
-    if (local_addr.ss_family == addr.ss_family) {
+    if (local_family == addr.ss_family) {
         return true;
     }
 
     // 如果本地是 IPv4，传入是 IPv6
-    if (local_addr.ss_family == AF_INET && addr.ss_family == AF_INET6) {
+    if (local_family == AF_INET && addr.ss_family == AF_INET6) {
         // 检查传入的 IPv6 地址是否是 IPv4 映射的地址
         struct sockaddr_in6 *addr6 = reinterpret_cast<struct sockaddr_in6 *>(&addr);
         if (IN6_IS_ADDR_V4MAPPED(&addr6->sin6_addr)) {
@@ -79,7 +95,7 @@ bool SipSession::make_peer_addr(struct sockaddr_storage &addr) {
     }
 
     // 如果本地是 IPv6，传入是 IPv4
-    if (local_addr.ss_family == AF_INET6 && addr.ss_family == AF_INET) {
+    if (local_family == AF_INET6 && addr.ss_family == AF_INET) {
         // 将传入的 IPv4 地址转换为 IPv6 映射的地址
         struct sockaddr_in *addr4 = reinterpret_cast<struct sockaddr_in *>(&addr);
         struct sockaddr_in6 peer6{};
@@ -103,7 +119,7 @@ bool SipSession::make_peer_addr(struct sockaddr_storage &addr) {
 
 void SipSession::set_peer(struct sockaddr_storage &addr) {
     // tcp 模式下，与 udp session 模式下都不需要设置对端地址
-    if(!is_udp() ||  !get_peer_ip().empty()) {
+    if (!is_unbound()) {
         return;
     }
     if (addr.ss_family == AF_INET6 || addr.ss_family == AF_INET) {
@@ -113,22 +129,153 @@ void SipSession::set_peer(struct sockaddr_storage &addr) {
     }
 }
 
+bool SipSession::is_unbound() const {
+    return is_udp() && getSock() && getSock()->get_peer_ip().empty();
+}
+
+bool SipSession::get_peer_addr(struct sockaddr_storage &addr) {
+    if (is_unbound()) {
+        if (_addr.ss_family != AF_INET && _addr.ss_family != AF_INET6) {
+            return false;
+        }
+        memcpy(&addr, &_addr, sizeof(struct sockaddr_storage));
+        return true;
+    }
+    return getSock() && SockUtil::get_sock_peer_addr(getSock()->rawFD(), addr);
+}
+
+std::string SipSession::get_peer_ip() {
+    if (is_unbound() && (_addr.ss_family == AF_INET || _addr.ss_family == AF_INET6)) {
+        return SockUtil::inet_ntoa((struct sockaddr *)&_addr);
+    }
+    return Session::get_peer_ip();
+}
+
+uint16_t SipSession::get_peer_port() {
+    if (is_unbound() && (_addr.ss_family == AF_INET || _addr.ss_family == AF_INET6)) {
+        return SockUtil::inet_port((struct sockaddr *)&_addr);
+    }
+    return Session::get_peer_port();
+}
+
+// 放入对象池的缓存上限, 更大的消息(如 tcp 上的目录应答)单独申请, 避免池中缓存长期占用峰值内存
+static constexpr size_t kMaxPooledSendSize = 4 * 1024;
+
+// 发送缓存对象池, 回收后保留已分配的内存, 避免每条消息重新申请
+static Buffer::Ptr make_send_buffer(const void *data, size_t bytes) {
+    if (bytes >= kMaxPooledSendSize) {
+        auto buffer = BufferRaw::create();
+        buffer->assign((const char *)data, bytes);
+        return buffer;
+    }
+    static ResourcePool<BufferRaw> pool;
+    static std::once_flag flag;
+    std::call_once(flag, []() { pool.setSize(1024); });
+    auto buffer = pool.obtain2();
+    buffer->assign((const char *)data, bytes);
+    return buffer;
+}
+
+bool SipSession::send_to(const void *data, size_t bytes, struct sockaddr_storage addr) {
+    if (!is_unbound() || !make_peer_addr(addr)) {
+        return false;
+    }
+    send_buffer(make_send_buffer(data, bytes), &addr);
+    return true;
+}
+
+void SipSession::send_buffer(toolkit::Buffer::Ptr buffer, const struct sockaddr_storage *addr) {
+    if (!getPoller()->isCurrentThread()) {
+        // 发送队列按 poller 线程划分, 切换到所属线程后再入队
+        auto self = std::dynamic_pointer_cast<SipSession>(shared_from_this());
+        if (addr) {
+            getPoller()->async([self, buffer = std::move(buffer), dest = *addr]() mutable {
+                self->send_buffer(std::move(buffer), &dest);
+            });
+        } else {
+            getPoller()->async([self, buffer = std::move(buffer)]() mutable { self->send_buffer(std::move(buffer)); });
+        }
+        return;
+    }
+    ticker_->resetTime(); // 重置保活
+#ifdef ENABLE_SIP_TRACE_LOG
+    TraceL << "sip send :\n" << std::string_view(buffer->data(), buffer->size());
+#endif
+    if (SipCapture::Instance().enabled()) {
+        capture(SipCapture::Direction::out, buffer->data(), buffer->size(), addr);
+    }
+    auto &sock = getSock();
+    if (!sock) {
+        return;
+    }
+    // 未绑定对端地址的 udp socket, 需要指定发送地址; 共享的发送 session 由调用方传入目标地址
+    if (is_unbound()) {
+        auto dest = addr ? addr : &_addr;
+        SipEgress::Instance().send(sock, std::move(buffer), (sockaddr *)dest, SockUtil::get_sock_len((sockaddr *)dest));
+    } else {
+        SipEgress::Instance().send(sock, std::move(buffer), nullptr, 0);
+    }
+}
+
+void SipSession::capture(
+    SipCapture::Direction direction, const char *data, size_t size, const struct sockaddr_storage *addr) {
+    SipCapture::Instance().write(
+        direction, is_udp(), (const struct sockaddr *)(addr ? addr : &cached_peer_addr()), _sock_local_port, data,
+        size);
+}
+
+const struct sockaddr_storage &SipSession::cached_peer_addr() {
+    // 对端地址只获取一次, 避免每条报文都产生系统调用
+    if (!_cached_peer_ready) {
+        _cached_peer_ready = true;
+        get_peer_addr(_cached_peer);
+    }
+    return _cached_peer;
+}
+
+void SipSession::load_local_addr() {
+    auto &sock = getSock();
+    struct sockaddr_storage addr {};
+    if (!sock || sock->rawFD() < 0 || !SockUtil::get_sock_local_addr(sock->rawFD(), addr)) {
+        return;
+    }
+    _local_family = addr.ss_family;
+    _sock_local_port = SockUtil::inet_port((struct sockaddr *)&addr);
+    _sock_local_ip = SockUtil::inet_ntoa((struct sockaddr *)&addr);
+    _via_local.clear();
+}
+
+void SipSession::set_local_ip(const std::string &ip) {
+    // 每次获取 session 都会设置, 值不变时保留已格式化的 Via
+    if (local_ip_ != ip) {
+        local_ip_ = ip;
+        _via_local.clear();
+    }
+}
+
+const std::string &SipSession::via_local() {
+    if (!_via_local.empty()) {
+        return _via_local;
+    }
+    // 这里的获取都是不靠谱的, 需要提前设置local_host, 与 local_port
+    std::string ip = local_ip_.empty() ? _sock_local_ip : local_ip_;
+    if (ip.empty()) {
+        // 默认网卡地址, 全进程只获取一次
+        static std::string default_ip = SockUtil::get_local_ip();
+        ip = default_ip;
+    }
+    _via_local = ip + ":" + std::to_string(_sock_local_port);
+    return _via_local;
+}
+
 void SipSession::startConnect(
     const std::string &host, uint16_t port, uint16_t local_port, const std::string &local_ip,
     const std::function<void(const toolkit::SockException &ex)> &cb, float timeout_sec) {
     std::weak_ptr<SipSession> weak_self = std::dynamic_pointer_cast<SipSession>(shared_from_this());
 
-    _timer = std::make_shared<Timer>(
-        2.0f,
-        [weak_self]() {
-            auto strong_self = weak_self.lock();
-            if (!strong_self) {
-                return false;
-            }
-            strong_self->onManager();
-            return true;
-        },
-        getPoller());
+    // 客户端连接未纳入 TcpServer 管理, 同样由时间轮检测空闲
+    auto server = getSipServer();
+    start_idle_check(server ? server->get_account().session_idle_timeout * 1000ull : 60 * 1000);
 
     auto sock_ptr = getSock().get();
 
@@ -142,7 +289,6 @@ void SipSession::startConnect(
             // Socket has been reconnected, last socket's event is ignored
             return;
         }
-        strong_self->_timer.reset();
         TraceL << strong_self->getIdentifier() << " on err: " << ex;
         strong_self->onError(ex);
     });
@@ -165,12 +311,10 @@ void SipSession::onSockConnect(const toolkit::SockException &ex) {
     if (ex) {
         // 连接失败  [AUTO-TRANSLATED:33415985]
         // Connection failed
-        _timer.reset();
+        _idle_timeout_ms = 0;
         return;
     }
-    if (local_ip_.empty()) {
-        local_ip_ = SockUtil::get_local_ip(getSock()->rawFD());
-    }
+    load_local_addr();
 
     auto sock_ptr = getSock().get();
     std::weak_ptr<SipSession> weak_self = std::dynamic_pointer_cast<SipSession>(shared_from_this());
@@ -214,17 +358,10 @@ int SipSession::sip_via(void *transport, const char *destination, char protocol[
         return -1;
     }
     snprintf(protocol, 16, "%s", session->is_udp() ? "UDP" : "TCP");
-    // 这里的获取都是不靠谱的, 需要提前设置local_host, 与 local_port
-    if (session->local_ip_.empty())
-    {
-        if (session->getSock() && session->getSock()->rawFD()) {
-            session->local_ip_ = SockUtil::get_local_ip(session->getSock()->rawFD());
-        }
-    }
-    if (session->local_ip_.empty()){
-        session->local_ip_ = SockUtil::get_local_ip();
-    }
-    snprintf(local, 128, "%s:%d", session->local_ip_.c_str(), session->get_local_port());
+    auto &via = session->via_local();
+    auto len = (std::min)(via.size(), static_cast<size_t>(127));
+    memcpy(local, via.data(), len);
+    local[len] = '\0';
     return 0;
 }
 
@@ -241,25 +378,12 @@ int SipSession::sip_send(void *transport, const void *data, size_t bytes) {
         return sip_unknown_host;
     }
 
-    if (session_ptr->is_udp() && session_ptr->getSock()->get_peer_ip().empty() && session_ptr->_addr.ss_family != AF_INET && session_ptr->_addr.ss_family != AF_INET6) {
+    if (session_ptr->is_unbound() && session_ptr->_addr.ss_family != AF_INET && session_ptr->_addr.ss_family != AF_INET6) {
         WarnL << "SipSession::sip_send: invalid address family";
         return sip_unknown_host;
     }
-    auto buffer = toolkit::BufferRaw::create();
-    buffer->assign((const char *)data, bytes);
-    static auto sip_send_l = [](const std::shared_ptr<SipSession> &session_ptr,  Buffer::Ptr buffer) {
-        if (!session_ptr) return;
-        session_ptr->ticker_->resetTime(); // 重置保活
-        TraceL << "sip send :\n" << std::string_view(buffer->data(), buffer->size());
-        if(session_ptr->is_udp() && session_ptr->getSock()->get_peer_ip().empty()) {
-            session_ptr->getSock()->send(std::move(buffer), (sockaddr *)&session_ptr->_addr, SockUtil::get_sock_len((sockaddr *)&session_ptr->_addr));
-        } else {
-            session_ptr->send(std::move(buffer));
-        }
-    };
-    session_ptr->getPoller()->async([session_ptr, buffer = std::move(buffer)]() {
-        sip_send_l(session_ptr, std::move(buffer));
-    });
+    // 处于 poller 线程时(libsip 回调中的常见情况)直接入队, 否则由 send_buffer 切换线程
+    session_ptr->send_buffer(make_send_buffer(data, bytes));
     return 0;
 }
 int SipSession::sip_send_reply(
@@ -270,11 +394,7 @@ int SipSession::sip_send_reply(
     auto session_ptr = std::dynamic_pointer_cast<SipSession>((static_cast<SipSession *>(param))->shared_from_this());
     if (session_ptr == nullptr)
         return sip_unknown_host;
-    auto buffer = BufferRaw::create();
-    buffer->assign((const char *)data, bytes);
-    TraceL << "sip send :\n" << std::string_view(buffer->data(), buffer->size());
-    session_ptr->ticker_->resetTime();
-    session_ptr->send(std::move(buffer));
+    session_ptr->send_buffer(make_send_buffer(data, bytes));
     return 0;
 }
 sip_transport_t *SipSession::get_transport() {
@@ -284,260 +404,325 @@ sip_transport_t *SipSession::get_transport() {
     return &transport;
 }
 
+struct RecvStatistics {
+    std::atomic<uint64_t> count { 0 };
+    std::atomic<uint64_t> cost_us { 0 };
+};
+static RecvStatistics s_udp_recv;
+static RecvStatistics s_tcp_recv;
+
+static void add_recv_statistics(RecvStatistics &statistics, std::chrono::steady_clock::time_point begin) {
+    auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+    statistics.count.fetch_add(1, std::memory_order_relaxed);
+    statistics.cost_us.fetch_add(static_cast<uint64_t>(cost.count()), std::memory_order_relaxed);
+}
 
+void SipSession::get_recv_statistics(server_statistics &statistics) {
+    statistics.udp_recv_messages = s_udp_recv.count.load(std::memory_order_relaxed);
+    statistics.udp_recv_cost_us = s_udp_recv.cost_us.load(std::memory_order_relaxed);
+    statistics.tcp_recv_messages = s_tcp_recv.count.load(std::memory_order_relaxed);
+    statistics.tcp_recv_cost_us = s_tcp_recv.cost_us.load(std::memory_order_relaxed);
+}
 
-std::string print_recv_message(const struct http_parser_t* parser, HTTP_PARSER_MODE mode) {
-    std::stringstream ss;
-    int i, r;
-    {
-        std::string protocol(10, ' ');
-        int vermajor,verminor;
-        r = http_get_version(parser, protocol.data(), &vermajor, &verminor);
-        ss << trim(std::move(protocol), " ")  << "/" << vermajor << "." << verminor;
+void SipSession::input_message(const SipFramer::Frame &frame) {
+    auto begin = std::chrono::steady_clock::now();
+    if (frame.type == SipFramer::MessageType::request && !admit(frame)) {
+        return;
     }
-    ss << "\n";
-    if (mode == HTTP_PARSER_MODE::HTTP_PARSER_REQUEST) {
-        ss << http_get_request_method(parser);
-        ss << ' ';
-        ss << http_get_request_uri(parser);
-    } else {
-        ss << http_get_status_code(parser);
-        ss << ' ';
-        ss << http_get_status_reason(parser);
-    }
-    ss << "\n";
-    const char* name;
-    const char* value;
-    for (i = 0; i < http_get_header_count(parser) && 0 == r; i++)
-    {
-        if(0 != http_get_header(parser, i, &name, &value))
-            continue;
-        ss << name << ": " << value << "\n";
-    }
-    if (http_get_content_length(parser)) {
-        ss << "\n";
-        ss << std::string_view((char *)http_get_content(parser), http_get_content_length(parser));
-    }
-    return ss.str();
-}
-
-std::shared_ptr<toolkit::Buffer> SipSession::get_sip_message_type(const std::shared_ptr<toolkit::Buffer> &buffer) {
-    if (buffer->size() == 0) return nullptr;
-    static std::array<std::string_view, 14> patterns {
-        SIP_METHOD_INVITE,
-        SIP_METHOD_CANCEL,
-        SIP_METHOD_BYE,
-        SIP_METHOD_ACK,
-        SIP_METHOD_OPTIONS,
-        SIP_METHOD_REGISTER,
-        SIP_METHOD_PRACK,
-        SIP_METHOD_INFO,
-        SIP_METHOD_REFER,
-        SIP_METHOD_MESSAGE,
-        SIP_METHOD_SUBSCRIBE,
-        SIP_METHOD_NOTIFY,
-        SIP_METHOD_PUBLISH,
-        SIP_METHOD_UPDATE,
-    };
-    constexpr std::string_view sip_flag = "SIP/2.0";
-
-    std::string_view data(buffer->data(), buffer->size());
-    if (_message_buffer) {
-        auto temp_buff = std::dynamic_pointer_cast<toolkit::BufferLikeString>(_message_buffer);
-        temp_buff->append(buffer->data(), buffer->size());
-        data = std::string_view(temp_buff->data(), temp_buff->size());
-    }
-    auto crlf_pos = data.find('\n');
-    // 如果没找到一行，则退出
-    if (crlf_pos == std::string_view::npos) {
-        if (!_message_buffer) {
-            auto temp_buff = std::make_shared<toolkit::BufferLikeString>();
-            temp_buff->append(buffer->data(), buffer->size());
-        }
-        // 丢弃无效数据
-        else if (_message_buffer->size() > 8*1024) {
-            auto temp_buff = std::make_shared<toolkit::BufferLikeString>();
-            temp_buff->append(buffer->data() + buffer->size() - 1024, 1024);
-            _message_buffer = std::move(temp_buff);
-        }
-        return nullptr;
+    auto mode = frame.type == SipFramer::MessageType::request ? HTTP_PARSER_REQUEST : HTTP_PARSER_RESPONSE;
+    auto http_parse = SipParserPool::Instance().obtain(mode);
+    if (!http_parse) {
+        ErrorP(this) << "create http parser failed";
+        return;
+    }
+    auto len = frame.size;
+    auto ret = http_parser_input(http_parse.get(), frame.data, &len);
+    if (ret < 0) {
+        ErrorP(this) << "SIP message parser failed";
+        return;
+    }
+    if (ret != 0) {
+        // 分帧器已经根据 Content-Length 确认了消息边界, 此时不应该再需要更多数据
+        ErrorP(this) << "unexpected status code " << ret;
+        return;
+    }
+#ifdef ENABLE_SIP_TRACE_LOG
+    TraceP(this) << "input recv sip message : \n" << std::string_view(frame.data, frame.size - len);
+#endif
+    if (SipCapture::Instance().enabled()) {
+        capture(SipCapture::Direction::in, frame.data, frame.size - len);
     }
 
+    // 创建一个sip 消息
+    auto sip_message = sip_message_create(mode == HTTP_PARSER_REQUEST ? SIP_MESSAGE_REQUEST : SIP_MESSAGE_REPLY);
+    if (sip_message == nullptr) {
+        ErrorP(this) << "SIP message parser failed";
+        return;
+    }
+    if (sip_message_load(sip_message, http_parse.get()) != 0) {
+        ErrorP(this) << "SIP message creation/loading failed";
+        sip_message_destroy(sip_message);
+        return;
+    }
+    // 设置 rport
+    sip_agent_set_rport(sip_message, get_peer_ip().c_str(), get_peer_port());
 
-
-    auto check_line = [&](const std::string_view &line)-> size_t {
-        // 没有sip 标记， 不是有效的sip行
-        auto sip_pos = line.find(sip_flag);
-        if (sip_pos == std::string_view::npos) {
-            return sip_pos;
+    if (is_udp()) {
+        // udp 快速路径: 数据报已经是完整消息, 直接在接收线程内交给协议栈处理
+        if (sip_agent_input(_sip_agent, sip_message, this) != 0) {
+            ErrorP(this) << "SIP agent input failed";
         }
+        // 必须在此处销毁输入的消息，否则 libsip内部自动回复将被泄露
+        sip_message_destroy(sip_message);
+        add_recv_statistics(s_udp_recv, begin);
+        return;
+    }
 
-        // SIP/2.0 200 OK\r\n
-        if (sip_pos + sip_flag.size() + 4 <= line.size()) {
-            // 确保SIP标志后是空格+3位数字
-            if (std::isblank(line[sip_pos + sip_flag.size()])) {
-                auto status_start = sip_pos + sip_flag.size() + 1;
-                if (std::isdigit(line[status_start]) &&
-                    std::isdigit(line[status_start+1]) &&
-                    std::isdigit(line[status_start+2])) {
-                    _wait_type = SIP_MESSAGE_TYPE_RESPONSE;
-                    _sip_parse = std::shared_ptr<http_parser_t>(http_parser_create(HTTP_PARSER_RESPONSE, nullptr , nullptr), http_parser_destroy);
-                    return sip_pos;
-                    }
+    auto weak_this = std::weak_ptr<SipSession>(std::dynamic_pointer_cast<SipSession>(shared_from_this()));
+    auto message_bytes = frame.size;
+    _message_bytes += message_bytes;
+    ++_queued_messages;
+    if (auto server = getSipServer()) {
+        server->add_recv_queued(0, 1);
+    }
+    // 将处理放入线程异步，继续解析剩余的消息, 将 http_parse 捕获， 防止SIP BODY 不可用
+    getPoller()->async([weak_this, sip_message, http_parse = std::move(http_parse), begin, message_bytes]() {
+        if(auto this_ptr = weak_this.lock()) {
+            if (sip_agent_input(this_ptr->_sip_agent, sip_message, this_ptr.get()) != 0) {
+                ErrorP(this_ptr.get()) << "SIP agent input failed";
             }
-        }
-        // METHOD sip:xxxxxxxxx SIP/2.0\r\n
-        for (auto &pattern : patterns) {
-            auto method_start = line.find(pattern);
-            if (method_start != std::string_view::npos && method_start < sip_pos && std::isblank(line[method_start + pattern.size()])) {
-                _wait_type = SIP_MESSAGE_TYPE_REQUEST;
-                _sip_parse = std::shared_ptr<http_parser_t>(http_parser_create(HTTP_PARSER_REQUEST, nullptr , nullptr), http_parser_destroy);
-                return method_start;
+            // 必须在此处销毁输入的消息，否则 libsip内部自动回复将被泄露
+            sip_message_destroy(sip_message);
+            this_ptr->_message_bytes -= message_bytes;
+            --this_ptr->_queued_messages;
+            auto server = this_ptr->getSipServer();
+            if (server) {
+                server->add_recv_queued(0, -1);
             }
-        }
-        return std::string_view::npos;
-    };
-    size_t pos = 0;
-
-    auto get_buffer = [&](size_t start)-> std::shared_ptr<toolkit::Buffer> {
-        if (pos == 0 && start == 0) {
-            std::shared_ptr<toolkit::Buffer> buff = _message_buffer ? _message_buffer : buffer;
-            _message_buffer.reset();
-            return std::dynamic_pointer_cast<toolkit::Buffer>(buff);
-        }
-
-        if (_message_buffer) {
-            auto temp_buff = std::dynamic_pointer_cast<toolkit::BufferLikeString>(_message_buffer);
-            temp_buff->erase(0, pos + start);
-            _message_buffer.reset();
-            return std::dynamic_pointer_cast<toolkit::Buffer>(temp_buff);
-        }
-
-        auto temp_buff = std::make_shared<toolkit::BufferLikeString>();
-        temp_buff->append(buffer->data() + pos + start, buffer->size());
-        return std::dynamic_pointer_cast<toolkit::Buffer>(temp_buff);
-    };
-
-    do {
-        auto line = data.substr(pos, crlf_pos);
-        // 已经确认消息状态
-        if (auto start = check_line(line); start != std::string_view::npos) {
-            return get_buffer(start);
-        }
-        if (crlf_pos + 1 >= data.size()) {
-            crlf_pos = std::string_view::npos;
+            this_ptr->sync_queued(server);
+            // 等待处理的消息减少后, 继续分帧剩余数据并检查是否恢复读取
+            if (this_ptr->_framer.buffered()) {
+                this_ptr->schedule_recv();
+            }
+            this_ptr->check_backpressure(server);
         } else {
-            pos = crlf_pos + 1;
-            crlf_pos = data.find('\n', pos);
+            // 销毁消息
+            sip_message_destroy(sip_message);
         }
-
-    } while (crlf_pos != std::string_view::npos);
-
-    return nullptr;
+        add_recv_statistics(s_tcp_recv, begin);
+    }, false);
 }
 
 void SipSession::handle_recv() {
-    if (_handing_recv.exchange(true)) {
+    _recv_scheduled = false;
+    auto server = getSipServer();
+    size_t max_messages = server ? server->get_account().session_max_queued_messages : 0;
+    SipFramer::Frame frame;
+    // 等待处理的消息达到上限后停止分帧, 剩余数据留在缓存中
+    while ((max_messages == 0 || _queued_messages < max_messages) && _framer.next(frame)) {
+        input_message(frame);
+    }
+    if (_framer.error()) {
+        // 无法确定消息边界, 后续数据都不可信
+        _framer.clear();
+        sync_queued(server);
+        shutdown(SockException(Err_other, "sip message too large"));
         return;
     }
-    while (!_recv_buffers.empty()) {
-        // 获取当前缓冲区数据
-        auto buffer = (_wait_type == SIP_MESSAGE_TYPE_NEED_MORE)
-            ? get_sip_message_type(_recv_buffers.front())
-            : std::move(_recv_buffers.front());
-        _recv_buffers.pop_front();
+    sync_queued(server);
+    check_backpressure(server);
+}
 
-        if (!buffer || buffer->size() == 0 || _wait_type == SIP_MESSAGE_TYPE_NEED_MORE) {
-            continue;  // 继续处理下个缓冲区
+void SipSession::schedule_recv() {
+    if (_recv_scheduled) {
+        return;
+    }
+    _recv_scheduled = true;
+    // 加入异步队列， 等待数据接收完毕
+    getPoller()->async([weak_this = weak_from_this()]() {
+        if (auto this_ptr = std::dynamic_pointer_cast<SipSession>(weak_this.lock())) {
+            this_ptr->handle_recv();
         }
+    }, false);
+}
 
-        auto len = buffer->size();
-        auto ret = http_parser_input(_sip_parse.get(), buffer->data(), &len);
-        // 解析器需要更多数据
-        if (ret == 1) {
-            TraceP(this) << "need more data by http parser";
-            continue;
+void SipSession::sync_queued(const std::shared_ptr<SipServer> &server) {
+    auto queued = _framer.buffered() + _message_bytes;
+    if (server && (queued != _queued_bytes)) {
+        server->add_recv_queued(static_cast<int64_t>(queued) - static_cast<int64_t>(_queued_bytes), 0);
+    }
+    _queued_bytes = queued;
+}
+
+void SipSession::check_backpressure(const std::shared_ptr<SipServer> &server) {
+    if (!server || is_udp() || !getSock()) {
+        return;
+    }
+    auto &account = server->get_account();
+    size_t max_bytes = account.session_max_queued_bytes;
+    size_t max_messages = account.session_max_queued_messages;
+    if (!_recv_paused) {
+        if ((max_bytes && _queued_bytes > max_bytes) || (max_messages && _queued_messages >= max_messages)
+            || server->is_recv_overloaded()) {
+            _recv_paused = true;
+            getSock()->enableRecv(false);
+            server->on_tcp_paused();
+            WarnP(this) << "recv queue overloaded, pause reading, queued bytes: " << _queued_bytes
+                        << ", queued messages: " << _queued_messages;
+            // 服务整体过载时本连接可能没有待处理的消息, 需要定时检查恢复
+            std::weak_ptr<SipSession> weak_this = std::dynamic_pointer_cast<SipSession>(shared_from_this());
+            getPoller()->doDelayTask(100, [weak_this]() -> uint64_t {
+                auto this_ptr = weak_this.lock();
+                if (!this_ptr || !this_ptr->_recv_paused) {
+                    return 0;
+                }
+                this_ptr->check_backpressure(this_ptr->getSipServer());
+                return this_ptr->_recv_paused ? 100 : 0;
+            });
         }
-        //保存剩余数据
-        if (len > 0 && len < buffer->size()) {
-            TraceP(this) << "has remaining data size = " << len;
+        return;
+    }
+    // 降到上限的一半以下才恢复读取, 避免频繁切换
+    if ((max_bytes && _queued_bytes > max_bytes / 2) || (max_messages && _queued_messages > max_messages / 2)
+        || server->is_recv_overloaded()) {
+        return;
+    }
+    _recv_paused = false;
+    getSock()->enableRecv(true);
+    InfoP(this) << "recv queue drained, resume reading";
+}
 
-            auto remaining = toolkit::BufferRaw::create();
-            remaining->assign(buffer->data() + (buffer->size() - len), len);
-            _recv_buffers.push_front(std::move(remaining));
+// 根据请求构造 503 应答, 复制事务相关的头域
+static std::string make_overload_reply(const SipFramer::Frame &frame, uint32_t retry_after) {
+    static constexpr std::string_view kHeaders[] = { "via", "v", "from", "f", "to", "t", "call-id", "i", "cseq" };
+    std::string reply = "SIP/2.0 503 Service Unavailable\r\n";
+    bool has_call_id = false, has_cseq = false;
+    auto data = frame.data;
+    auto end = frame.data + frame.size;
+    // 跳过起始行
+    auto pos = static_cast<const char *>(memchr(data, '\n', frame.size));
+    while (pos && ++pos < end) {
+        auto line_end = static_cast<const char *>(memchr(pos, '\n', end - pos));
+        auto size = static_cast<size_t>((line_end ? line_end : end) - pos);
+        if (size && pos[size - 1] == '\r') {
+            --size;
         }
-        if (ret < 0) {
-            ErrorP(this) << "SIP message parser failed";
-            _wait_type = SIP_MESSAGE_TYPE_NEED_MORE;
-            continue;
+        if (size == 0) {
+            break;
         }
-        if (ret == 0) {
-            TraceP(this) << "input recv sip message : \n" << std::string_view(buffer->data(), buffer->size() - len);
-
-            // 创建一个sip 消息
-            auto sip_message
-                = sip_message_create(_wait_type == HTTP_PARSER_REQUEST ? SIP_MESSAGE_REQUEST : SIP_MESSAGE_REPLY);
-            if (sip_message == nullptr) {
-                ErrorP(this) << "SIP message parser failed";
-                _wait_type = SIP_MESSAGE_TYPE_NEED_MORE;
-                continue;
-            }
-            if (sip_message_load(sip_message, _sip_parse.get()) != 0) {
-                ErrorP(this) << "SIP message creation/loading failed";
-                sip_message_destroy(sip_message);
-                _wait_type = SIP_MESSAGE_TYPE_NEED_MORE;
-                continue;
+        for (auto &name : kHeaders) {
+            size_t value_pos = 0;
+            if (SipFramer::is_header(pos, size, name, value_pos)) {
+                has_call_id |= name == "call-id" || name == "i";
+                has_cseq |= name == "cseq";
+                reply.append(pos, size).append("\r\n");
+                break;
             }
-            // 设置 rport
-            sip_agent_set_rport(sip_message, get_peer_ip().c_str(), get_peer_port());
-
-            auto weak_this = std::weak_ptr<SipSession>(std::dynamic_pointer_cast<SipSession>(shared_from_this()));
-            // 将处理放入线程异步，继续解析剩余的消息, 将 http_parse 捕获， 防止SIP BODY 不可用
-            getPoller()->async([weak_this, sip_message, http_parse = std::move(_sip_parse)]() {
-                if(auto this_ptr = weak_this.lock()) {
-                    if (sip_agent_input(this_ptr->_sip_agent, sip_message, this_ptr.get()) != 0) {
-                        ErrorP(this_ptr.get()) << "SIP agent input failed";
-                    }
-                    // 必须在此处销毁输入的消息，否则 libsip内部自动回复将被泄露
-                    sip_message_destroy(sip_message);
-                } else {
-                    // 销毁消息
-                    sip_message_destroy(sip_message);
-                }
-            }, false);
-            _wait_type = SIP_MESSAGE_TYPE_NEED_MORE;
+        }
+        pos = line_end;
+    }
+    if (!has_call_id || !has_cseq) {
+        return "";
+    }
+    reply.append("Retry-After: ").append(std::to_string(retry_after)).append("\r\n");
+    reply.append("Content-Length: 0\r\n\r\n");
+    return reply;
+}
 
-        } else {
-            ErrorP(this) << "unexpected status code " << ret;
-            _wait_type = SIP_MESSAGE_TYPE_NEED_MORE;
+bool SipSession::admit(const SipFramer::Frame &frame) {
+    auto method = SipAdmission::sniff_method(frame.data, frame.size);
+    if (method == SipAdmission::Method::other) {
+        return true;
+    }
+    auto server = getSipServer();
+    if (!server || server->admission().admit(method, cached_peer_addr())) {
+        return true;
+    }
+    // 超出速率, 不再解析, 按过载策略回复 503 或丢弃
+    auto retry_after = server->get_account().overload_retry_after;
+    if (retry_after) {
+        auto reply = make_overload_reply(frame, retry_after);
+        if (!reply.empty()) {
+            send_buffer(make_send_buffer(reply.data(), reply.size()));
         }
     }
-    _handing_recv.exchange(false);
+    return false;
+}
+
+void SipSession::shed_udp(SipServer &server, const SipFramer::Frame &frame) {
+    auto retry_after = server.get_account().overload_retry_after;
+    // ACK 没有应答, 只能丢弃
+    if (retry_after && frame.type == SipFramer::MessageType::request
+        && !(frame.size > 4 && memcmp(frame.data, "ACK ", 4) == 0)) {
+        auto reply = make_overload_reply(frame, retry_after);
+        if (!reply.empty()) {
+            send_buffer(make_send_buffer(reply.data(), reply.size()));
+            server.on_udp_rejected();
+            return;
+        }
+    }
+    server.on_udp_dropped();
 }
 
 
 void SipSession::onRecv(const toolkit::Buffer::Ptr &buffer) {
+#ifdef ENABLE_SIP_TRACE_LOG
     TraceL << "recv " << buffer->size() << " bytes" << ", local: " << get_local_ip() << ", remote: " << get_peer_ip();
+#endif
     ticker_->resetTime();
-    _recv_buffers.push_back(buffer);
-    // 加入异步队列， 等待数据接收完毕
-    getPoller()->async([weak_this = weak_from_this()]() {
-        if (auto this_ptr = std::dynamic_pointer_cast<SipSession>(weak_this.lock())) {
-            this_ptr->handle_recv();
+    if (is_udp()) {
+        // udp 数据报总是一个完整的消息, 无需缓存
+        SipFramer::Frame frame;
+        if (SipFramer::parse_datagram(buffer->data(), buffer->size(), frame)) {
+            // 服务过载(缓存字节数或等待处理的消息数超限)时, udp 请求回复 503 或直接丢弃
+            auto server = getSipServer();
+            if (!server) {
+                input_message(frame);
+                return;
+            }
+            if (server->is_recv_overloaded()) {
+                shed_udp(*server, frame);
+                return;
+            }
+            // udp 在接收线程内同步处理, 处理期间计入服务的消息数; 协议栈回调阻塞时各 poller 上的 udp 消息累积,
+            // 与 tcp 等待处理的消息一起触发过载
+            server->add_recv_queued(0, 1);
+            input_message(frame);
+            server->add_recv_queued(0, -1);
         }
-    }, false);
+        return;
+    }
+    _framer.input(buffer->data(), buffer->size());
+    auto server = getSipServer();
+    sync_queued(server);
+    check_backpressure(server);
+    schedule_recv();
 }
 
 void SipSession::onError(const toolkit::SockException &err) {
     WarnP(this) << ", " << err;
+    _closed_by_error = err.getErrCode() != Err_eof && err.getErrCode() != Err_shutdown;
     if (_on_error) _on_error(err);
 }
 void SipSession::onManager() {
-    // udp client 未纳入udpServer session 管理，所以不会执行次函数
-    // Tcp client 同样未纳入
-    if (ticker_->elapsedTime() > 60 * 1000) {
-        shutdown(SockException(Err_timeout, "session timeout"));
+    // 空闲检测由 SipIdleWheel 负责, 不再逐个遍历
+}
+
+void SipSession::send_ping() {
+    static constexpr char kPing[] = "\r\n\r\n";
+    send_buffer(make_send_buffer(kPing, sizeof(kPing) - 1));
+}
+
+void SipSession::start_idle_check(uint64_t timeout_ms) {
+    if (timeout_ms == 0) {
+        return;
+    }
+    auto self = std::dynamic_pointer_cast<SipSession>(shared_from_this());
+    if (getPoller()->isCurrentThread()) {
+        SipIdleWheel::Instance().add(self, timeout_ms);
+        return;
     }
+    getPoller()->async([self, timeout_ms]() { SipIdleWheel::Instance().add(self, timeout_ms); });
 }
 
 } // namespace gb28181
@@ -1,8 +1,12 @@
 #ifndef gb28181_src_inner_SIP_SESSION_H
 #define gb28181_src_inner_SIP_SESSION_H
 
+#include <atomic>
 #include "Network/Session.h"
+#include "gb28181/type_define.h"
 #include "http-parser.h"
+#include "sip_capture.h"
+#include "sip_framer.h"
 #ifdef __cplusplus
 extern "C" {
 struct http_parser_t;
@@ -29,10 +33,42 @@ public:
     void set_peer(const std::string &host, uint16_t port);
     void set_peer(struct sockaddr_storage &addr);
 
+    /**
+     * 获取对端地址, 未绑定对端的 udp session 返回 set_peer 设置的地址
+     */
+    bool get_peer_addr(struct sockaddr_storage &addr);
+    std::string get_peer_ip() override;
+    uint16_t get_peer_port() override;
+
     void onRecv(const toolkit::Buffer::Ptr &) override;
     void onError(const toolkit::SockException &err) override;
     void onManager() override;
     inline bool is_udp() const { return _is_udp; }
+    /**
+     * 复用 udp 监听 socket 的 session, socket 未绑定对端地址, 发送时需要指定目标地址
+     */
+    bool is_unbound() const;
+    /**
+     * 距离最后一次收发数据的时长(毫秒)
+     */
+    uint64_t elapsed_time() const { return ticker_->elapsedTime(); }
+    /**
+     * 加入所属 poller 的空闲检测时间轮, 超时后关闭连接
+     * @param timeout_ms 空闲超时时间, 为 0 时不检测
+     */
+    void start_idle_check(uint64_t timeout_ms);
+    /**
+     * 连接是否可用
+     */
+    bool is_alive() const { return getSock() && getSock()->alive(); }
+    /**
+     * 连接是否因错误(连接重置、超时等)关闭, 对端正常关闭或本端主动关闭时为 false, 可在任意线程调用
+     */
+    bool closed_by_error() const { return _closed_by_error; }
+    /**
+     * 发送 CRLF 保活(RFC 5626), 用于 tcp 连接池健康检查
+     */
+    void send_ping();
     void startConnect(
         const std::string &host, uint16_t port, uint16_t local_port, const std::string &local_ip,
         const std::function<void(const toolkit::SockException &ex)> &cb, float timeout_sec);
@@ -47,43 +83,72 @@ public:
 
     static sip_transport_t *get_transport();
 
+    /**
+     * 填充接收消息统计
+     */
+    static void get_recv_statistics(server_statistics &statistics);
+
     void onSockConnect(const toolkit::SockException &ex);
 
-    void set_local_ip(const std::string &ip) { local_ip_ = ip; }
+    void set_local_ip(const std::string &ip);
     void set_local_port(uint16_t port) { local_port_ = port; }
 
+    /**
+     * 通过未绑定对端的 udp session 向指定地址发送, 供多个平台共享同一个发送 session
+     */
+    bool send_to(const void *data, size_t bytes, struct sockaddr_storage addr);
+
 private:
     void handle_recv();
+    void send_buffer(toolkit::Buffer::Ptr buffer, const struct sockaddr_storage *addr = nullptr);
+    void input_message(const SipFramer::Frame &frame);
     bool make_peer_addr(struct sockaddr_storage &addr);
-
-    enum SIP_MESSAGE_TYPE {
-        SIP_MESSAGE_TYPE_RESPONSE = HTTP_PARSER_RESPONSE,
-        SIP_MESSAGE_TYPE_REQUEST = HTTP_PARSER_REQUEST,
-        SIP_MESSAGE_TYPE_NEED_MORE = 2,
-        HTTP_PARSER_NEED_NORE = 3
-    };
-    std::shared_ptr<toolkit::Buffer> get_sip_message_type(const std::shared_ptr<toolkit::Buffer> &buffer);
+    void capture(
+        SipCapture::Direction direction, const char *data, size_t size, const struct sockaddr_storage *addr = nullptr);
+    void schedule_recv();
+    void sync_queued(const std::shared_ptr<SipServer> &server);
+    void check_backpressure(const std::shared_ptr<SipServer> &server);
+    void shed_udp(SipServer &server, const SipFramer::Frame &frame);
+    bool admit(const SipFramer::Frame &frame);
+    const struct sockaddr_storage &cached_peer_addr();
+    /**
+     * 获取并缓存 socket 的本地地址, 在创建与连接成功时调用
+     */
+    void load_local_addr();
+    const std::string &via_local();
 
 private:
     bool _is_udp = false;
     bool _is_client = false;
-    std::atomic_bool _handing_recv{false};
-    SIP_MESSAGE_TYPE _wait_type {SIP_MESSAGE_TYPE_NEED_MORE};
     toolkit::Ticker _ticker;
     struct sockaddr_storage _addr {};
-    std::shared_ptr<http_parser_t> _sip_parse;
     sip_agent_t *_sip_agent {};
     std::weak_ptr<SipServer> _sip_server;
-    std::shared_ptr<toolkit::Timer> _timer;
     std::string local_ip_;
     uint16_t local_port_ { 0 };
     friend class SipServer;
+    friend class SipUdpListener;
+    friend class SipIdleWheel;
+    friend class SipUdpPeer;
+    uint64_t _idle_timeout_ms { 0 }; // 空闲超时时间, 由 SipIdleWheel 检测
 
     std::function<void(const toolkit::SockException &)> _on_error;
+    std::atomic_bool _closed_by_error { false };
     std::shared_ptr<toolkit::Ticker> ticker_; // 计时器
-    std::deque<toolkit::Buffer::Ptr> _recv_buffers;
-    std::shared_ptr<toolkit::Buffer> _message_buffer;
-    std::recursive_mutex _recv_buffers_mutex;
+    SipFramer _framer; // tcp 接收缓冲与分帧
+    struct sockaddr_storage _cached_peer {}; // 缓存的对端地址, 用于抓包与准入控制
+    bool _cached_peer_ready { false };
+    // socket 本地地址缓存, 避免每个请求都调用 getsockname
+    int _local_family { AF_UNSPEC };
+    uint16_t _sock_local_port { 0 };
+    std::string _sock_local_ip;
+    std::string _via_local; // 预先格式化的 Via "host:port"
+    // 接收过载保护, 只在 poller 线程访问
+    bool _recv_scheduled { false }; // 已投递分帧任务
+    bool _recv_paused { false }; // 已暂停 tcp 读取
+    size_t _message_bytes { 0 }; // 已分帧、等待协议栈处理的字节数
+    size_t _queued_messages { 0 }; // 已分帧、等待协议栈处理的消息数
+    size_t _queued_bytes { 0 }; // 已计入服务的缓存字节数
 };
 
 } // namespace gb28181
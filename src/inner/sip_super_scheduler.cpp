@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <chrono>
+#include <Poller/Timer.h>
+#include <Thread/WorkThreadPool.h>
+
+#include "sip_super_scheduler.h"
+#include "super_platform_impl.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+// 每个 tick 的时长与槽位数量, 一圈约 102 秒, 超过一圈的任务留在槽位中直到转到
+static constexpr uint64_t kTickUS = 100 * 1000;
+static constexpr size_t kSlotCount = 1024;
+
+static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void SipSuperScheduler::set_config(uint32_t jitter, uint32_t max_registering) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _jitter = (std::min)(jitter, 90u);
+    _max_registering = max_registering;
+}
+
+void SipSuperScheduler::start() {
+    std::lock_guard<std::mutex> lck(_mtx);
+    if (_timer) {
+        return;
+    }
+    if (_slots.empty()) {
+        _slots.resize(kSlotCount);
+        _start_us = now_us();
+    }
+    // 在后台线程推进, 不占用网络线程
+    _timer = std::make_shared<Timer>(
+        kTickUS / 1000000.0f,
+        [weak_this = weak_from_this()]() {
+            if (auto this_ptr = weak_this.lock()) {
+                this_ptr->on_tick();
+                return true;
+            }
+            return false;
+        },
+        WorkThreadPool::Instance().getPoller());
+}
+
+void SipSuperScheduler::stop() {
+    std::shared_ptr<Timer> timer;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        timer.swap(_timer);
+    }
+    timer.reset();
+}
+
+void SipSuperScheduler::schedule_register(
+    const std::shared_ptr<SuperPlatformImpl> &platform, uint64_t seq, int expires, std::string authorization,
+    uint64_t delay_ms) {
+    Entry entry;
+    entry.platform = platform;
+    entry.type = TaskType::registration;
+    entry.seq = seq;
+    entry.expires = expires;
+    entry.authorization = std::move(authorization);
+    add(std::move(entry), delay_ms);
+}
+
+void SipSuperScheduler::schedule_keepalive(
+    const std::shared_ptr<SuperPlatformImpl> &platform, uint64_t seq, uint64_t delay_ms) {
+    Entry entry;
+    entry.platform = platform;
+    entry.type = TaskType::keepalive;
+    entry.seq = seq;
+    add(std::move(entry), delay_ms);
+}
+
+void SipSuperScheduler::release_register() {
+    _registering.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void SipSuperScheduler::get_statistics(server_statistics &statistics) const {
+    statistics.super_registering = _registering.load(std::memory_order_relaxed);
+    statistics.super_register_waiting = _waiting_count.load(std::memory_order_relaxed);
+    statistics.super_schedule_executed = _executed.load(std::memory_order_relaxed);
+    statistics.super_schedule_slip_us = _slip_us.load(std::memory_order_relaxed);
+    statistics.super_schedule_slip_max_us = _slip_max_us.load(std::memory_order_relaxed);
+}
+
+void SipSuperScheduler::add(Entry &&entry, uint64_t delay_ms) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto delay_us = delay_ms * 1000;
+    if (_jitter && delay_us) {
+        // 只提前不推后: 注册刷新不会晚于过期时间, 心跳间隔不会超过对端的超时判定
+        delay_us -= std::uniform_int_distribution<uint64_t>(0, delay_us * _jitter / 100)(_rand);
+    }
+    entry.deadline_us = now_us() + delay_us;
+    _pending.emplace_back(std::move(entry));
+}
+
+void SipSuperScheduler::insert(Entry &&entry) {
+    // 向上取整, 保证不早于到期时间执行
+    uint64_t tick = entry.deadline_us > _start_us ? (entry.deadline_us - _start_us + kTickUS - 1) / kTickUS : 0;
+    entry.tick = (std::max)(tick, _tick + 1);
+    auto &slot = _slots[entry.tick % kSlotCount];
+    slot.emplace_back(std::move(entry));
+}
+
+void SipSuperScheduler::on_tick() {
+    std::vector<Entry> pending;
+    uint32_t max_registering = 0;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        pending.swap(_pending);
+        max_registering = _max_registering;
+    }
+    for (auto &entry : pending) {
+        insert(std::move(entry));
+    }
+
+    // 按实际经过的时间推进, 定时器回调推迟时一次补齐多个 tick
+    auto target = (now_us() - _start_us) / kTickUS;
+    while (_tick < target) {
+        auto &slot = _slots[++_tick % kSlotCount];
+        if (slot.empty()) {
+            continue;
+        }
+        std::vector<Entry> entries;
+        entries.swap(slot);
+        for (auto &entry : entries) {
+            if (entry.tick > _tick) {
+                // 还未转到, 留在本槽位
+                slot.emplace_back(std::move(entry));
+            } else if (entry.type == TaskType::registration) {
+                _waiting.emplace_back(std::move(entry));
+            } else {
+                dispatch(std::move(entry));
+            }
+        }
+    }
+
+    // 名额在注册结束时释放, 在下一个 tick 分配给排队的注册
+    while (!_waiting.empty()
+           && (!max_registering || _registering.load(std::memory_order_relaxed) < max_registering)) {
+        _registering.fetch_add(1, std::memory_order_relaxed);
+        auto entry = std::move(_waiting.front());
+        _waiting.pop_front();
+        dispatch(std::move(entry));
+    }
+    _waiting_count.store(_waiting.size(), std::memory_order_relaxed);
+}
+
+void SipSuperScheduler::dispatch(Entry &&entry) {
+    auto platform = entry.platform.lock();
+    if (!platform) {
+        if (entry.type == TaskType::registration) {
+            release_register();
+        }
+        return;
+    }
+    platform->get_poller()->async(
+        [weak_this = weak_from_this(), platform, entry = std::move(entry)]() {
+            bool executed = entry.type == TaskType::registration
+                ? platform->on_register_due(entry.seq, entry.expires, entry.authorization)
+                : platform->on_keepalive_due(entry.seq);
+            auto this_ptr = weak_this.lock();
+            if (!this_ptr) {
+                return;
+            }
+            if (executed) {
+                this_ptr->on_executed(entry.deadline_us);
+            } else if (entry.type == TaskType::registration) {
+                // 任务已被取消, 未发起注册
+                this_ptr->release_register();
+            }
+        },
+        false);
+}
+
+void SipSuperScheduler::on_executed(uint64_t deadline_us) {
+    // 延迟包括时间轮精度、等待注册名额与平台 poller 的排队时间
+    auto now = now_us();
+    uint64_t slip = now > deadline_us ? now - deadline_us : 0;
+    _executed.fetch_add(1, std::memory_order_relaxed);
+    _slip_us.fetch_add(slip, std::memory_order_relaxed);
+    auto max = _slip_max_us.load(std::memory_order_relaxed);
+    while (slip > max && !_slip_max_us.compare_exchange_weak(max, slip, std::memory_order_relaxed)) {}
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_super_scheduler.cpp
+创建时间:   26-10-17 下午11:59
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:59
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:59       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,117 @@
+#ifndef gb28181_src_inner_SIP_SUPER_SCHEDULER_H
+#define gb28181_src_inner_SIP_SUPER_SCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "gb28181/type_define.h"
+
+namespace toolkit {
+class Timer;
+}
+
+namespace gb28181 {
+class SuperPlatformImpl;
+
+/**
+ * 上级平台注册与心跳调度
+ * 所有上级平台的注册刷新、注册重试与心跳共用一个 100 毫秒的时间轮, 在后台线程推进, 到期后投递到平台的 poller 执行;
+ * 每次调度将到期时间随机提前一定比例, 同时启动的平台在几个周期后即相互错开;
+ * 同时进行中的注册数受限, 超出的注册按到期顺序排队; 记录任务实际执行时间晚于到期时间的延迟
+ */
+class SipSuperScheduler : public std::enable_shared_from_this<SipSuperScheduler> {
+public:
+    enum class TaskType : uint8_t {
+        registration, // 注册、注销或注册刷新
+        keepalive, // 心跳
+    };
+
+    /**
+     * @param jitter 到期时间随机提前的最大比例(百分比)
+     * @param max_registering 同时进行中的注册数上限, 为 0 时不限制
+     */
+    void set_config(uint32_t jitter, uint32_t max_registering);
+
+    /**
+     * 开始调度, 在后台线程推进; 开始之前加入的任务在开始后执行
+     */
+    void start();
+    void stop();
+
+    /**
+     * 调度注册, 可在任意线程调用; 到期且有空闲名额时调用平台的 on_register_due
+     * @param seq 平台的注册序号, 平台以此判断任务是否已被取消
+     */
+    void schedule_register(
+        const std::shared_ptr<SuperPlatformImpl> &platform, uint64_t seq, int expires, std::string authorization,
+        uint64_t delay_ms);
+    /**
+     * 调度心跳, 可在任意线程调用; 到期后调用平台的 on_keepalive_due
+     */
+    void schedule_keepalive(const std::shared_ptr<SuperPlatformImpl> &platform, uint64_t seq, uint64_t delay_ms);
+
+    /**
+     * 注册结束(收到最终回复或发送失败), 释放名额
+     */
+    void release_register();
+
+    void get_statistics(server_statistics &statistics) const;
+
+private:
+    struct Entry {
+        std::weak_ptr<SuperPlatformImpl> platform;
+        TaskType type { TaskType::keepalive };
+        uint64_t seq { 0 };
+        int expires { 0 };
+        std::string authorization;
+        uint64_t deadline_us { 0 }; // 加入抖动后的到期时间
+        uint64_t tick { 0 }; // 到期的 tick
+    };
+    void add(Entry &&entry, uint64_t delay_ms);
+    void insert(Entry &&entry);
+    void on_tick();
+    void dispatch(Entry &&entry);
+    void on_executed(uint64_t deadline_us);
+
+private:
+    std::mutex _mtx;
+    uint32_t _jitter { 0 };
+    uint32_t _max_registering { 0 };
+    std::minstd_rand _rand { std::random_device {}() };
+    std::vector<Entry> _pending; // 待加入时间轮的任务
+    std::shared_ptr<toolkit::Timer> _timer;
+    // 以下仅在调度线程访问
+    std::vector<std::vector<Entry>> _slots;
+    std::deque<Entry> _waiting; // 已到期、等待名额的注册
+    uint64_t _start_us { 0 };
+    uint64_t _tick { 0 };
+
+    std::atomic<uint32_t> _registering { 0 };
+    std::atomic<uint64_t> _waiting_count { 0 };
+    std::atomic<uint64_t> _executed { 0 };
+    std::atomic<uint64_t> _slip_us { 0 };
+    std::atomic<uint64_t> _slip_max_us { 0 };
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_SUPER_SCHEDULER_H
+
+/**********************************************************************************************************
+文件名称:   sip_super_scheduler.h
+创建时间:   26-10-17 下午11:59
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:59
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:59       描述:   创建文件
+
+**********************************************************************************************************/
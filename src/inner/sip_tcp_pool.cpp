@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <Poller/Timer.h>
+#include <Util/util.h>
+
+#include "sip_session.h"
+#include "sip_tcp_pool.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+// 健康检查间隔
+static constexpr float kCheckIntervalSec = 5.0f;
+// 连接空闲超过该时长时发送 CRLF 保活
+static constexpr uint64_t kPingIdleMS = 20 * 1000;
+// 后台重连失败后的重试间隔, 每次失败加倍
+static constexpr uint64_t kRetryMinMS = 5 * 1000;
+static constexpr uint64_t kRetryMaxMS = 5 * 60 * 1000;
+
+SipTcpPool::SipTcpPool(std::string local, Connector connector, uint64_t standby_ms)
+    : _local(std::move(local))
+    , _connector(std::move(connector))
+    , _standby_ms(standby_ms) {}
+
+SipTcpPool::~SipTcpPool() {
+    _timer.reset();
+}
+
+void SipTcpPool::start(const EventPoller::Ptr &poller) {
+    std::weak_ptr<SipTcpPool> weak_self = shared_from_this();
+    _timer = std::make_shared<Timer>(
+        kCheckIntervalSec,
+        [weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->on_check();
+                return true;
+            }
+            return false;
+        },
+        poller);
+}
+
+std::string SipTcpPool::make_key(const struct sockaddr_storage &addr) const {
+    return _local + "|" + SockUtil::inet_ntoa((const struct sockaddr *)&addr) + ":"
+        + std::to_string(SockUtil::inet_port((const struct sockaddr *)&addr));
+}
+
+void SipTcpPool::obtain(const struct sockaddr_storage &addr, Callback cb) {
+    auto key = make_key(addr);
+    std::shared_ptr<SipSession> session;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        auto &entry = _entries[key];
+        entry.addr = addr;
+        entry.last_used = getCurrentMillisecond(true);
+        if (entry.session && entry.session->is_alive()) {
+            session = entry.session;
+        } else {
+            entry.session.reset();
+            entry.pending.emplace_back(std::move(cb));
+            if (entry.connecting) {
+                // 已有连接正在建立, 等待其结果
+                return;
+            }
+            entry.connecting = true;
+        }
+    }
+    if (session) {
+        cb(SockException(), session);
+        return;
+    }
+    connect(key, addr);
+}
+
+void SipTcpPool::connect(const std::string &key, const struct sockaddr_storage &addr) {
+    std::weak_ptr<SipTcpPool> weak_self = shared_from_this();
+    _connector(addr, [weak_self, key](const SockException &ex, std::shared_ptr<SipSession> session) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->on_connected(key, ex, session);
+        }
+    });
+}
+
+void SipTcpPool::on_connected(const std::string &key, const SockException &ex, const std::shared_ptr<SipSession> &session) {
+    std::vector<Callback> pending;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        auto it = _entries.find(key);
+        if (it == _entries.end()) {
+            return;
+        }
+        auto &entry = it->second;
+        entry.connecting = false;
+        entry.pending.swap(pending);
+        if (!ex && session) {
+            entry.session = session;
+            entry.failures = 0;
+        } else {
+            // 连接失败, 按退避间隔在后台重试
+            entry.standby = true;
+            auto backoff = kRetryMinMS << (std::min)(entry.failures, 16u);
+            entry.retry_time = getCurrentMillisecond(true) + (std::min)(backoff, kRetryMaxMS);
+            ++entry.failures;
+        }
+    }
+    for (auto &cb : pending) {
+        cb(ex, ex ? nullptr : session);
+    }
+}
+
+void SipTcpPool::on_check() {
+    auto now = getCurrentMillisecond(true);
+    std::vector<std::pair<std::string, struct sockaddr_storage>> reconnects;
+    std::vector<std::shared_ptr<SipSession>> sessions;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            auto &entry = it->second;
+            if (entry.connecting) {
+                ++it;
+                continue;
+            }
+            if (now - entry.last_used > _standby_ms) {
+                // 长时间未使用, 不再保留; 仍被平台持有的连接由空闲检测关闭
+                it = _entries.erase(it);
+                continue;
+            }
+            if (entry.session && !entry.session->is_alive()) {
+                // 只有异常断开的连接需要热备, 正常关闭的连接等待下次使用时重新建立
+                entry.standby = entry.session->closed_by_error();
+                entry.retry_time = 0;
+                entry.session.reset();
+            }
+            if (entry.session) {
+                sessions.emplace_back(entry.session);
+            } else if (entry.standby && now >= entry.retry_time) {
+                // 最近使用过的对端, 后台重连保持热备
+                entry.connecting = true;
+                reconnects.emplace_back(it->first, entry.addr);
+            }
+            ++it;
+        }
+    }
+    for (auto &session : sessions) {
+        // 收发时间只在连接所属线程更新, 切换到该线程后再判断是否空闲
+        session->getPoller()->async(
+            [session]() {
+                if (session->elapsed_time() > kPingIdleMS) {
+                    session->send_ping();
+                }
+            },
+            false);
+    }
+    for (auto &item : reconnects) {
+        connect(item.first, item.second);
+    }
+}
+
+void SipTcpPool::clear() {
+    std::unordered_map<std::string, Entry> entries;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        entries.swap(_entries);
+    }
+    for (auto &it : entries) {
+        for (auto &cb : it.second.pending) {
+            cb(SockException(Err_other, "tcp pool cleared"), nullptr);
+        }
+    }
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_tcp_pool.cpp
+创建时间:   26-10-17 下午6:10
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午6:10
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午6:10       描述:   创建文件
+
+**********************************************************************************************************/
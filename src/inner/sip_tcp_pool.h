@@ -0,0 +1,92 @@
+#ifndef gb28181_src_inner_SIP_TCP_POOL_H
+#define gb28181_src_inner_SIP_TCP_POOL_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Network/Socket.h"
+
+namespace toolkit {
+class Timer;
+}
+namespace gb28181 {
+class SipSession;
+
+/**
+ * 出站 tcp 连接池
+ * 以 (本地地址, 对端地址) 为键复用连接, 同一对端同时只发起一次连接, 期间的请求排队等待结果;
+ * 定时检查连接状态, 空闲的连接发送 CRLF 保活; 最近使用过的对端在连接异常断开或连接失败后后台重连, 保持热备,
+ * 连续失败时重连间隔按指数退避; 对端正常关闭或本端主动关闭的连接不重连, 下次使用时再建立
+ */
+class SipTcpPool : public std::enable_shared_from_this<SipTcpPool> {
+public:
+    using Ptr = std::shared_ptr<SipTcpPool>;
+    using Callback = std::function<void(const toolkit::SockException &, std::shared_ptr<SipSession>)>;
+    using Connector = std::function<void(const struct sockaddr_storage &addr, Callback cb)>;
+
+    /**
+     * @param local 本地地址, 作为键的一部分
+     * @param connector 建立新连接的方法
+     * @param standby_ms 连接最后一次使用后保留与热备的时长
+     */
+    SipTcpPool(std::string local, Connector connector, uint64_t standby_ms);
+    ~SipTcpPool();
+
+    /**
+     * 启动健康检查
+     */
+    void start(const toolkit::EventPoller::Ptr &poller);
+
+    /**
+     * 获取到对端的连接, 没有可用连接时发起连接或等待正在进行的连接
+     */
+    void obtain(const struct sockaddr_storage &addr, Callback cb);
+
+    void clear();
+
+private:
+    struct Entry {
+        struct sockaddr_storage addr {};
+        std::shared_ptr<SipSession> session;
+        std::vector<Callback> pending; // 等待连接结果的请求
+        bool connecting { false };
+        bool standby { false }; // 没有可用连接时是否后台重连
+        uint32_t failures { 0 }; // 连续连接失败次数
+        uint64_t retry_time { 0 }; // 下一次后台重连的最早时间(毫秒)
+        uint64_t last_used { 0 }; // 最后一次获取连接的时间(毫秒)
+    };
+
+    std::string make_key(const struct sockaddr_storage &addr) const;
+    void connect(const std::string &key, const struct sockaddr_storage &addr);
+    void on_connected(const std::string &key, const toolkit::SockException &ex, const std::shared_ptr<SipSession> &session);
+    void on_check();
+
+private:
+    std::string _local;
+    Connector _connector;
+    uint64_t _standby_ms;
+    std::shared_ptr<toolkit::Timer> _timer;
+    std::mutex _mtx;
+    std::unordered_map<std::string, Entry> _entries;
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_TCP_POOL_H
+
+/**********************************************************************************************************
+文件名称:   sip_tcp_pool.h
+创建时间:   26-10-17 下午6:10
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午6:10
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午6:10       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <Poller/EventPoller.h>
+#include <Util/util.h>
+
+#include "sip_timer_wheel.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+static constexpr uint64_t kTickMS = 10;
+static constexpr uint64_t kNearBits = 8;
+static constexpr uint64_t kLevelBits = 6;
+static constexpr uint64_t kNearMask = (1 << kNearBits) - 1;
+static constexpr uint64_t kLevelMask = (1 << kLevelBits) - 1;
+static constexpr uint64_t kMiddleRange = 1 << (kNearBits + kLevelBits);
+static constexpr uint64_t kFarRange = 1 << (kNearBits + 2 * kLevelBits);
+static constexpr size_t kChunkSize = 256;
+
+// 节点状态, 低 2 位为状态, 其余为节点被复用的代数
+static constexpr uint32_t kStatusMask = 3;
+static constexpr uint32_t kFree = 0;
+static constexpr uint32_t kArmed = 1;
+static constexpr uint32_t kFired = 2;
+static constexpr uint32_t kCancelled = 3;
+// 节点按 64 字节对齐, 句柄的低 6 位保存代数, 用于识别已回收复用的节点
+static constexpr uintptr_t kTagMask = 63;
+// 节点不属于共享池
+static constexpr uint32_t kLocalNode = UINT32_MAX;
+
+struct alignas(64) SipTimerWheel::Node : SipTimerWheel::Link {
+    std::atomic<uint32_t> state { kFree };
+    std::atomic<SipTimerWheel *> wheel { nullptr }; // 所属时间轮
+    uint64_t expire { 0 }; // 到期的 tick
+    Handler handler { nullptr };
+    void *param { nullptr };
+    Node *next_free { nullptr };
+    uint32_t pool_index { kLocalNode }; // 在共享池中的序号
+    std::atomic<uint32_t> pool_next { 0 }; // 共享池空闲栈中下一个节点的序号 + 1
+};
+
+/**
+ * 非 poller 线程启动定时器时使用的共享节点池
+ * 节点由目标时间轮接管, 回收时放回本池而不是时间轮的空闲链表, 节点总数不超过同时存在的此类定时器数;
+ * 空闲节点组成无锁栈, 栈顶高 32 位为版本号避免 ABA, 节点按序号寻址, 分块分配后不再释放
+ */
+class SipTimerRemotePool {
+public:
+    static SipTimerRemotePool &Instance() {
+        // 定时器可能在静态对象析构之后停止, 池不释放
+        static auto instance = new SipTimerRemotePool();
+        return *instance;
+    }
+
+    SipTimerWheel::Node *pop() {
+        auto head = _head.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head)) {
+            auto node = at(static_cast<uint32_t>(head) - 1);
+            auto next = node->pool_next.load(std::memory_order_relaxed);
+            if (_head.compare_exchange_weak(
+                    head, (((head >> 32) + 1) << 32) | next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return node;
+            }
+        }
+        return grow();
+    }
+
+    void push(SipTimerWheel::Node *node) {
+        auto head = _head.load(std::memory_order_relaxed);
+        do {
+            node->pool_next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        } while (!_head.compare_exchange_weak(
+            head, (((head >> 32) + 1) << 32) | (node->pool_index + 1), std::memory_order_release,
+            std::memory_order_relaxed));
+    }
+
+private:
+    static constexpr size_t kMaxChunks = 4096;
+
+    SipTimerWheel::Node *at(uint32_t index) const {
+        return _chunks[index / kChunkSize].load(std::memory_order_acquire) + index % kChunkSize;
+    }
+
+    SipTimerWheel::Node *grow() {
+        std::lock_guard<std::mutex> lck(_mtx);
+        if (_count >= kMaxChunks) {
+            return nullptr;
+        }
+        auto chunk = new SipTimerWheel::Node[kChunkSize];
+        auto base = static_cast<uint32_t>(_count * kChunkSize);
+        for (size_t i = 0; i < kChunkSize; ++i) {
+            chunk[i].pool_index = base + static_cast<uint32_t>(i);
+        }
+        _chunks[_count++].store(chunk, std::memory_order_release);
+        // 第一个节点直接返回, 其余放入空闲栈
+        for (size_t i = 1; i < kChunkSize; ++i) {
+            push(&chunk[i]);
+        }
+        return &chunk[0];
+    }
+
+private:
+    std::atomic<uint64_t> _head { 0 }; // 高 32 位版本号, 低 32 位为栈顶节点序号 + 1, 0 表示空
+    std::atomic<SipTimerWheel::Node *> _chunks[kMaxChunks] {};
+    std::mutex _mtx;
+    size_t _count { 0 };
+};
+
+static inline void unlink(SipTimerWheel::Link *link) {
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->prev = link->next = link;
+}
+
+static inline void link_tail(SipTimerWheel::Link &head, SipTimerWheel::Link *link) {
+    link->prev = head.prev;
+    link->next = &head;
+    head.prev->next = link;
+    head.prev = link;
+}
+
+// 将槽位中的节点整体移到 to, 处理过程中新加入的节点不会落到 to 中
+static inline void splice(SipTimerWheel::Link &from, SipTimerWheel::Link &to) {
+    if (from.next == &from) {
+        return;
+    }
+    to.next = from.next;
+    to.prev = from.prev;
+    to.next->prev = &to;
+    to.prev->next = &to;
+    from.prev = from.next = &from;
+}
+
+static inline void *make_handle(void *node, uint32_t state) {
+    return reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(node) | ((state >> 2) & kTagMask));
+}
+
+static thread_local SipTimerWheel *s_current_wheel = nullptr;
+
+SipTimerWheel::SipTimerWheel(EventPoller *poller)
+    : _poller(poller)
+    , _base(getCurrentMillisecond()) {}
+
+SipTimerWheel::~SipTimerWheel() {
+    s_current_wheel = nullptr;
+}
+
+SipTimerWheel *SipTimerWheel::current() {
+    return s_current_wheel;
+}
+
+SipTimerWheel &SipTimerWheel::Instance() {
+    static thread_local SipTimerWheel instance(EventPoller::getCurrentPoller().get());
+    s_current_wheel = &instance;
+    return instance;
+}
+
+void *SipTimerWheel::start(int timeout_ms, Handler handler, void *param) {
+    auto timeout = static_cast<uint64_t>((std::max)(timeout_ms, 0));
+    auto wheel = current();
+    if (!wheel && EventPoller::getCurrentPoller()) {
+        wheel = &Instance();
+    }
+    if (wheel) {
+        auto node = wheel->alloc();
+        node->handler = handler;
+        node->param = param;
+        auto state = (node->state.load(std::memory_order_relaxed) & ~kStatusMask) | kArmed;
+        node->state.store(state, std::memory_order_release);
+        wheel->add(node, timeout);
+        return make_handle(node, state);
+    }
+    // 非 poller 线程(例如业务线程直接发送请求), 节点取自共享池, 由目标 poller 加入时间轮, 到期或取消后放回共享池
+    auto node = SipTimerRemotePool::Instance().pop();
+    if (!node) {
+        return nullptr;
+    }
+    node->handler = handler;
+    node->param = param;
+    auto state = (node->state.load(std::memory_order_relaxed) & ~kStatusMask) | kArmed;
+    node->state.store(state, std::memory_order_release);
+    EventPollerPool::Instance().getPoller()->async(
+        [node, timeout]() {
+            auto &wheel = Instance();
+            node->wheel.store(&wheel, std::memory_order_release);
+            wheel.add(node, timeout);
+        },
+        false);
+    return make_handle(node, state);
+}
+
+int SipTimerWheel::stop(void *id) {
+    auto value = reinterpret_cast<uintptr_t>(id);
+    auto node = reinterpret_cast<Node *>(value & ~kTagMask);
+    auto state = node->state.load(std::memory_order_acquire);
+    if ((state & kStatusMask) != kArmed || ((state >> 2) & kTagMask) != (value & kTagMask)) {
+        return -1;
+    }
+    if (!node->state.compare_exchange_strong(
+            state, (state & ~kStatusMask) | kCancelled, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        // 回调已经开始执行
+        return -1;
+    }
+    // 所属线程内立即摘除并回收; 其他线程只做标记, 节点到期或迁移槽位时由所属线程回收
+    auto wheel = current();
+    if (wheel && node->wheel.load(std::memory_order_acquire) == wheel && node->prev != node) {
+        unlink(node);
+        --wheel->_size;
+        wheel->recycle(node);
+    }
+    return 0;
+}
+
+SipTimerWheel::Node *SipTimerWheel::alloc() {
+    if (!_free) {
+        std::unique_ptr<Node[]> chunk(new Node[kChunkSize]);
+        for (size_t i = 0; i < kChunkSize; ++i) {
+            chunk[i].wheel.store(this, std::memory_order_relaxed);
+            chunk[i].next_free = _free;
+            _free = &chunk[i];
+        }
+        _chunks.emplace_back(std::move(chunk));
+    }
+    auto node = _free;
+    _free = node->next_free;
+    return node;
+}
+
+void SipTimerWheel::recycle(Node *node) {
+    // 代数加一, 之前发出的句柄不再匹配
+    auto state = node->state.load(std::memory_order_relaxed);
+    node->state.store(((state >> 2) + 1) << 2 | kFree, std::memory_order_release);
+    node->handler = nullptr;
+    node->param = nullptr;
+    if (node->pool_index != kLocalNode) {
+        // 共享池的节点不再属于本时间轮, 其他线程的 stop 不会再把它当作本线程的节点摘除
+        node->wheel.store(nullptr, std::memory_order_relaxed);
+        SipTimerRemotePool::Instance().push(node);
+        return;
+    }
+    node->next_free = _free;
+    _free = node;
+}
+
+void SipTimerWheel::add(Node *node, uint64_t timeout_ms) {
+    if ((node->state.load(std::memory_order_acquire) & kStatusMask) != kArmed) {
+        // 加入前已被其他线程取消
+        recycle(node);
+        return;
+    }
+    auto elapsed = getCurrentMillisecond() - _base;
+    if (!_size) {
+        // 时间轮为空时直接对齐到当前时间, 跳过空闲期间的 tick
+        _tick = (std::max)(_tick, elapsed / kTickMS);
+    }
+    // 向上取整, 保证不早于超时时间触发
+    node->expire = (std::max)(_tick + 1, (elapsed + timeout_ms + kTickMS - 1) / kTickMS);
+    insert(node);
+    ++_size;
+    schedule();
+}
+
+void SipTimerWheel::insert(Node *node) {
+    auto expire = node->expire;
+    auto delta = expire - _tick;
+    if (delta < (1 << kNearBits)) {
+        link_tail(_near[expire & kNearMask], node);
+    } else if (delta < kMiddleRange) {
+        link_tail(_middle[(expire >> kNearBits) & kLevelMask], node);
+    } else {
+        // 超出时间轮范围的节点放在最远的槽位, 迁移时按实际到期时间重新放入
+        if (delta >= kFarRange) {
+            expire = _tick + kFarRange - 1;
+        }
+        link_tail(_far[(expire >> (kNearBits + kLevelBits)) & kLevelMask], node);
+    }
+}
+
+void SipTimerWheel::cascade(Link &slot) {
+    Link list;
+    splice(slot, list);
+    while (list.next != &list) {
+        auto node = static_cast<Node *>(list.next);
+        unlink(node);
+        if ((node->state.load(std::memory_order_acquire) & kStatusMask) == kCancelled) {
+            --_size;
+            recycle(node);
+            continue;
+        }
+        insert(node);
+    }
+}
+
+void SipTimerWheel::expire(Link &slot) {
+    Link list;
+    splice(slot, list);
+    // 回调中可能启动或停止其他定时器, 每次只从临时链表头部取一个节点
+    while (list.next != &list) {
+        auto node = static_cast<Node *>(list.next);
+        unlink(node);
+        if (node->expire > _tick) {
+            // 超出时间轮范围的节点, 尚未到期
+            insert(node);
+            continue;
+        }
+        --_size;
+        auto state = node->state.load(std::memory_order_acquire);
+        if ((state & kStatusMask) == kArmed
+            && node->state.compare_exchange_strong(
+                state, (state & ~kStatusMask) | kFired, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            node->handler(node->param);
+        }
+        recycle(node);
+    }
+}
+
+void SipTimerWheel::advance() {
+    auto target = now_tick();
+    while (_tick < target) {
+        if (!_size) {
+            _tick = target;
+            break;
+        }
+        ++_tick;
+        if (!(_tick & kNearMask)) {
+            if (!((_tick >> kNearBits) & kLevelMask)) {
+                cascade(_far[(_tick >> (kNearBits + kLevelBits)) & kLevelMask]);
+            }
+            cascade(_middle[(_tick >> kNearBits) & kLevelMask]);
+        }
+        expire(_near[_tick & kNearMask]);
+    }
+}
+
+void SipTimerWheel::schedule() {
+    if (_scheduled) {
+        return;
+    }
+    _scheduled = true;
+    // 时间轮与线程同生命周期, 定时任务不会在时间轮销毁后执行
+    _poller->doDelayTask(kTickMS, [this]() -> uint64_t {
+        advance();
+        if (!_size) {
+            _scheduled = false;
+            return 0;
+        }
+        return kTickMS;
+    });
+}
+
+uint64_t SipTimerWheel::now_tick() const {
+    return (getCurrentMillisecond() - _base) / kTickMS;
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_timer_wheel.cpp
+创建时间:   26-10-17 下午11:55
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:55
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:55       描述:   创建文件
+
+**********************************************************************************************************/
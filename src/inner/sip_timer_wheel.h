@@ -0,0 +1,99 @@
+#ifndef gb28181_src_inner_SIP_TIMER_WHEEL_H
+#define gb28181_src_inner_SIP_TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace toolkit {
+class EventPoller;
+}
+
+namespace gb28181 {
+
+/**
+ * libsip 事务定时器的分层时间轮
+ * 每个 poller 线程独享一个时间轮, tick 为 10 毫秒, 三层槽位(256/64/64)覆盖约 2.9 小时, 更长的定时器在到期前重新放入;
+ * 定时器节点按线程池化并以侵入式链表挂在槽位上, 在所属线程内启动与停止都是 O(1) 且不加锁;
+ * 其他线程停止定时器只通过原子状态标记取消, 节点在到期时由所属线程回收;
+ * 非 poller 线程启动的定时器使用全局共享的无锁节点池, 节点由目标时间轮接管、回收时放回共享池;
+ * 时间轮为空时停止 tick 任务, 空闲的 poller 不会被周期唤醒
+ */
+class SipTimerWheel {
+public:
+    using Handler = void (*)(void *param);
+
+    /**
+     * 启动定时器, 在 poller 线程内调用时加入当前线程的时间轮, 否则投递到一个 poller
+     * @return 定时器句柄
+     */
+    static void *start(int timeout_ms, Handler handler, void *param);
+
+    /**
+     * 停止定时器
+     * @return 0 成功取消, 回调不会执行; -1 回调已经执行或正在执行
+     */
+    static int stop(void *id);
+
+    /**
+     * 当前线程时间轮中的定时器数量, 包含已取消、尚未回收的节点
+     */
+    size_t size() const { return _size; }
+
+    ~SipTimerWheel();
+
+    // 侵入式双向链表, 槽位为哨兵, 空链表指向自身
+    struct Link {
+        Link *prev { this };
+        Link *next { this };
+    };
+
+    struct Node;
+
+private:
+
+    explicit SipTimerWheel(toolkit::EventPoller *poller);
+    static SipTimerWheel *current();
+    static SipTimerWheel &Instance();
+
+    Node *alloc();
+    void recycle(Node *node);
+    void add(Node *node, uint64_t timeout_ms);
+    void insert(Node *node);
+    void cascade(Link &slot);
+    void expire(Link &slot);
+    void advance();
+    void schedule();
+    uint64_t now_tick() const;
+
+private:
+    toolkit::EventPoller *_poller; // 时间轮与所属线程同生命周期, 不持有 poller
+    Link _near[256]; // 第一层, 每个槽位 1 个 tick
+    Link _middle[64]; // 第二层, 每个槽位 256 个 tick
+    Link _far[64]; // 第三层, 每个槽位 16384 个 tick
+    uint64_t _base { 0 }; // tick 0 对应的时间(毫秒)
+    uint64_t _tick { 0 }; // 已处理到的 tick
+    size_t _size { 0 };
+    bool _scheduled { false };
+    Node *_free { nullptr }; // 空闲节点单链表
+    std::vector<std::unique_ptr<Node[]>> _chunks;
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_TIMER_WHEEL_H
+
+/**********************************************************************************************************
+文件名称:   sip_timer_wheel.h
+创建时间:   26-10-17 下午11:55
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:55
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:55       描述:   创建文件
+
+**********************************************************************************************************/
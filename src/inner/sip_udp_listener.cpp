@@ -0,0 +1,108 @@
+#include <Poller/Timer.h>
+
+#include "sip_server.h"
+#include "sip_session.h"
+#include "sip_udp_listener.h"
+
+using namespace toolkit;
+
+namespace gb28181 {
+
+
+SipUdpListener::SipUdpListener(const EventPoller::Ptr &poller, const std::shared_ptr<SipServer> &server)
+    : _poller(poller)
+    , _server(server) {}
+
+SipUdpListener::~SipUdpListener() {
+    _timer.reset();
+    if (_socket) {
+        _socket->setOnRead(nullptr);
+        _socket->closeSock();
+    }
+}
+
+bool SipUdpListener::start(uint16_t port, const std::string &host) {
+    _socket = Socket::createSocket(_poller, false);
+    // 同一端口在每个 poller 上各绑定一次, 依赖 SO_REUSEPORT 由内核分发
+    if (!_socket->bindUdpSock(port, host, true)) {
+        ErrorL << "bind udp " << host << ":" << port << " failed, " << get_uv_errmsg(true);
+        return false;
+    }
+    std::weak_ptr<SipUdpListener> weak_self = shared_from_this();
+    _socket->setOnRead([weak_self](const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+        if (auto strong_self = weak_self.lock()) {
+            strong_self->on_read(buf, addr, addr_len);
+        }
+    });
+    _socket->setOnErr([port](const SockException &ex) { WarnL << "udp listener " << port << " error: " << ex; });
+    _timer = std::make_shared<Timer>(
+        2.0f,
+        [weak_self]() {
+            if (auto strong_self = weak_self.lock()) {
+                strong_self->on_manager();
+                return true;
+            }
+            return false;
+        },
+        _poller);
+    return true;
+}
+
+void SipUdpListener::on_read(const Buffer::Ptr &buf, struct sockaddr *addr, int addr_len) {
+    if (addr == nullptr || addr_len <= 0) {
+        return;
+    }
+    std::string key((const char *)addr, addr_len);
+    auto it = _sessions.find(key);
+    if (it == _sessions.end()) {
+        auto server = _server.lock();
+        if (!server) {
+            return;
+        }
+        auto session = std::make_shared<SipSession>(_socket);
+        session->_sip_server = server;
+        session->_sip_agent = server->get_sip_agent().get();
+        struct sockaddr_storage peer {};
+        memcpy(&peer, addr, (std::min)(sizeof(peer), static_cast<size_t>(addr_len)));
+        session->set_peer(peer);
+        it = _sessions.emplace(std::move(key), std::move(session)).first;
+    }
+    auto session = it->second;
+    try {
+        session->onRecv(buf);
+    } catch (std::exception &ex) {
+        WarnL << "handle udp message from " << session->get_peer_ip() << " failed: " << ex.what();
+    }
+}
+
+void SipUdpListener::on_manager() {
+    // 共享监听 socket 的 session 不能通过 shutdown 关闭, 仅从表中移除
+    auto server = _server.lock();
+    uint64_t timeout_ms = server ? server->get_account().session_idle_timeout * 1000ull : 60 * 1000;
+    if (timeout_ms == 0) {
+        return;
+    }
+    for (auto it = _sessions.begin(); it != _sessions.end();) {
+        if (it->second->elapsed_time() > timeout_ms) {
+            it = _sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_udp_listener.cpp
+创建时间:   26-10-17 下午1:40
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午1:40
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午1:40       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,64 @@
+#ifndef gb28181_src_inner_SIP_UDP_LISTENER_H
+#define gb28181_src_inner_SIP_UDP_LISTENER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "Network/Socket.h"
+
+namespace toolkit {
+class Timer;
+}
+namespace gb28181 {
+class SipServer;
+class SipSession;
+
+/**
+ * 单个 poller 上的 udp 监听
+ * 每个 poller 使用 SO_REUSEPORT 绑定同一端口, 由内核按四元组分发数据报,
+ * 数据报在本线程批量读取后直接交给对端对应的 session 处理, 不再为每个对端创建新的 socket
+ */
+class SipUdpListener : public std::enable_shared_from_this<SipUdpListener> {
+public:
+    using Ptr = std::shared_ptr<SipUdpListener>;
+
+    SipUdpListener(const toolkit::EventPoller::Ptr &poller, const std::shared_ptr<SipServer> &server);
+    ~SipUdpListener();
+
+    /**
+     * 绑定端口并开始接收
+     */
+    bool start(uint16_t port, const std::string &host);
+
+    const toolkit::Socket::Ptr &socket() const { return _socket; }
+
+private:
+    void on_read(const toolkit::Buffer::Ptr &buf, struct sockaddr *addr, int addr_len);
+    void on_manager();
+
+private:
+    toolkit::EventPoller::Ptr _poller;
+    std::weak_ptr<SipServer> _server;
+    toolkit::Socket::Ptr _socket;
+    std::shared_ptr<toolkit::Timer> _timer;
+    // 对端地址 -> session, 只在本 poller 线程访问
+    std::unordered_map<std::string, std::shared_ptr<SipSession>> _sessions;
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_UDP_LISTENER_H
+
+/**********************************************************************************************************
+文件名称:   sip_udp_listener.h
+创建时间:   26-10-17 下午1:40
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午1:40
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午1:40       描述:   创建文件
+
+**********************************************************************************************************/
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstring>
+#include <Poller/EventPoller.h>
+#include <Util/logger.h>
+#include <sip-transport.h>
+
+#include "sip_common.h"
+#include "sip_server.h"
+#include "sip_session.h"
+#include "sip_udp_peer.h"
+
+using namespace toolkit;
+
+bool areAddressesEqual(const struct sockaddr_storage &a, const struct sockaddr_storage &b);
+
+namespace gb28181 {
+
+SipUdpPeer::SipUdpPeer(const std::shared_ptr<SipServer> &server)
+    : _server(server) {}
+
+bool SipUdpPeer::set_addr(const struct sockaddr_storage &addr) {
+    if (addr.ss_family != AF_INET && addr.ss_family != AF_INET6) {
+        return false;
+    }
+    // 比较与写入在同一把锁内, 多个线程同时收到消息时只有一个线程认为地址发生了变化
+    std::lock_guard<std::mutex> lck(_mtx);
+    if (areAddressesEqual(_addr, addr)) {
+        return false;
+    }
+    memcpy(&_addr, &addr, sizeof(_addr));
+    return true;
+}
+
+bool SipUdpPeer::get_addr(struct sockaddr_storage &addr) const {
+    std::lock_guard<std::mutex> lck(_mtx);
+    if (_addr.ss_family != AF_INET && _addr.ss_family != AF_INET6) {
+        return false;
+    }
+    memcpy(&addr, &_addr, sizeof(addr));
+    return true;
+}
+
+void SipUdpPeer::set_local_ip(const std::string &ip) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    // 每次发送前都会设置, 值不变时保留已格式化的 Via
+    if (_local_ip != ip) {
+        _local_ip = ip;
+        _via.clear();
+    }
+}
+
+std::shared_ptr<SipSession> SipUdpPeer::session() const {
+    auto server = _server.lock();
+    if (!server) {
+        return nullptr;
+    }
+    // 处于 poller 线程时使用该线程的发送 session, 发送不需要切换线程
+    return server->udp_send_session(EventPollerPool::Instance().getPoller().get());
+}
+
+int SipUdpPeer::sip_send(void *transport, const void *data, size_t bytes) {
+    if (transport == nullptr) {
+        return -1;
+    }
+    auto peer = static_cast<SipUdpPeer *>(transport);
+    struct sockaddr_storage addr {};
+    if (!peer->get_addr(addr)) {
+        WarnL << "SipUdpPeer::sip_send: invalid address family";
+        return sip_unknown_host;
+    }
+    auto session = peer->session();
+    if (!session || !session->send_to(data, bytes, addr)) {
+        WarnL << "SipUdpPeer::sip_send: no udp session available";
+        return sip_unknown_host;
+    }
+    return 0;
+}
+
+int SipUdpPeer::sip_via(void *transport, const char *destination, char protocol[16], char local[128], char dns[128]) {
+    if (transport == nullptr) {
+        return -1;
+    }
+    auto peer = static_cast<SipUdpPeer *>(transport);
+    auto session = peer->session();
+    if (!session) {
+        return -1;
+    }
+    snprintf(protocol, 16, "%s", "UDP");
+    std::lock_guard<std::mutex> lck(peer->_mtx);
+    if (peer->_via.empty()) {
+        // 所有发送 session 绑定同一端口, Via 只与平台的本地地址有关
+        peer->_via = peer->_local_ip.empty() ? session->via_local()
+                                             : peer->_local_ip + ":" + std::to_string(session->_sock_local_port);
+    }
+    auto len = (std::min)(peer->_via.size(), static_cast<size_t>(127));
+    memcpy(local, peer->_via.data(), len);
+    local[len] = '\0';
+    return 0;
+}
+
+sip_transport_t *SipUdpPeer::get_transport() {
+    static sip_transport_t transport;
+    transport.send = SipUdpPeer::sip_send;
+    transport.via = SipUdpPeer::sip_via;
+    return &transport;
+}
+
+} // namespace gb28181
+
+/**********************************************************************************************************
+文件名称:   sip_udp_peer.cpp
+创建时间:   26-10-17 下午11:40
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:40
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:40       描述:   创建文件
+
+**********************************************************************************************************/
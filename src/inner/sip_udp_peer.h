@@ -0,0 +1,71 @@
+#ifndef gb28181_src_inner_SIP_UDP_PEER_H
+#define gb28181_src_inner_SIP_UDP_PEER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include "Network/sockutil.h"
+
+#ifdef __cplusplus
+extern "C" {
+struct sip_transport_t;
+}
+#endif
+
+namespace gb28181 {
+class SipServer;
+class SipSession;
+
+/**
+ * 平台的 udp 发送目标
+ * 服务为每个 poller 持有一个复用监听 socket 的发送 session, 平台只保存目标地址与 Via 本地地址;
+ * 作为 libsip 事务的 transport 参数, 发送与重传时选用当前线程对应的发送 session 并指定目标地址
+ */
+class SipUdpPeer {
+public:
+    explicit SipUdpPeer(const std::shared_ptr<SipServer> &server);
+
+    /**
+     * 设置对端地址, 平台地址只保存在这里
+     * @return 地址有效且与原地址不同时返回 true
+     */
+    bool set_addr(const struct sockaddr_storage &addr);
+    bool get_addr(struct sockaddr_storage &addr) const;
+    void set_local_ip(const std::string &ip);
+
+    /**
+     * 当前线程对应的发送 session
+     */
+    std::shared_ptr<SipSession> session() const;
+
+    static struct sip_transport_t *get_transport();
+
+private:
+    static int sip_send(void *transport, const void *data, size_t bytes);
+    static int sip_via(void *transport, const char *destination, char protocol[16], char local[128], char dns[128]);
+
+private:
+    std::weak_ptr<SipServer> _server;
+    mutable std::mutex _mtx;
+    struct sockaddr_storage _addr {};
+    std::string _local_ip;
+    std::string _via; // 预先格式化的 Via "host:port"
+};
+
+} // namespace gb28181
+
+#endif // gb28181_src_inner_SIP_UDP_PEER_H
+
+/**********************************************************************************************************
+文件名称:   sip_udp_peer.h
+创建时间:   26-10-17 下午11:40
+作者名称:   Kevin
+文件路径:   src/inner
+功能描述:   ${MY_FILE_DESCRIPTION}
+修订时间:   26-10-17 下午11:40
+
+修订记录
+-----------------------------------------------------------------------------------------------------------
+1. Kevin       26-10-17 下午11:40       描述:   创建文件
+
+**********************************************************************************************************/
@@ -1,60 +1,36 @@
-#include "Poller/EventPoller.h"
 #include "sip-timer.h"
 #include "sip_common.h"
+#include "sip_timer_wheel.h"
 
+#include <Util/logger.h>
 #include <gb28181/sip_event.h>
 
-using namespace toolkit;
-
-struct sip_timer_context {
-    std::weak_ptr<EventPoller::DelayTask> task; // 任务
-    std::shared_ptr<toolkit::EventPoller> poller; // 任务所属线程
-    std::atomic_bool handle_flag{false};
-};
-
+using namespace gb28181;
 
+// 事务定时器由各 poller 线程的分层时间轮管理, 启动与停止不再创建延时任务与异步任务
 void sip_timer_init(void) {
 }
 void sip_timer_cleanup(void) {
 }
 
 sip_timer_t sip_timer_start(int timeout, sip_timer_handle handler, void* usrptr) {
-    auto poller = EventPollerPool::Instance().getPoller();
-
-    auto context = new sip_timer_context();
-    context->poller = poller;
-    context->task = poller->doDelayTask(timeout, [handler, usrptr, context]() {
-        TraceL << "handle timer " << context;
-        bool expected =  false;
-        if (context->handle_flag.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
-            handler(usrptr);
-        }
-        return 0;
-    });
-    TraceL << "add timer " << context << ", timeout=" << timeout << " ms";
-    return context;
+    auto id = SipTimerWheel::start(timeout, handler, usrptr);
+#ifdef ENABLE_SIP_TRACE_LOG
+    TraceL << "add timer " << id << ", timeout=" << timeout << " ms";
+#endif
+    return id;
 }
 
 int sip_timer_stop(sip_timer_t* id) {
     if (nullptr == id || nullptr == *id) {
         return -1;
     }
+#ifdef ENABLE_SIP_TRACE_LOG
     TraceL << "stop timer " << *id;
-    auto context = static_cast<sip_timer_context *>(*id);
-    if (context == nullptr) {
-        *id = nullptr;
-        return -1;
-    }
-    bool expected = false;
-    bool flag = context->handle_flag.compare_exchange_strong(expected, true, std::memory_order_acq_rel);
-    context->poller->async([context]() {
-        if (auto task = context->task.lock()) {
-            task->cancel();
-        }
-        delete context;
-    });
+#endif
+    auto ret = SipTimerWheel::stop(*id);
     *id = nullptr;
-    return flag ? 0 : -1;
+    return ret;
 }
 
 
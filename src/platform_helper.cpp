@@ -1,5 +1,7 @@
 #include "gb28181/sip_event.h"
 #include "gb28181/type_define_ext.h"
+#include "inner/device_code.h"
+#include "inner/keepalive_scanner.h"
 #include "inner/sip_common.h"
 #include "sip-message.h"
 #include "sip-uac.h"
@@ -11,6 +13,7 @@
 #include <gb28181/message/message_base.h>
 #include <inner/sip_server.h>
 #include <inner/sip_session.h>
+#include <inner/sip_udp_peer.h>
 #include <request/RequestProxyImpl.h>
 
 #include "platform_helper.h"
@@ -59,6 +62,38 @@ bool areAddressesEqual(const struct sockaddr_storage &a, const struct sockaddr_s
     }
 }
 
+static std::vector<EventPoller::Ptr> &affinity_pollers() {
+    static std::vector<EventPoller::Ptr> pollers = []() {
+        std::vector<EventPoller::Ptr> ret;
+        EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+            ret.emplace_back(std::static_pointer_cast<EventPoller>(executor));
+        });
+        return ret;
+    }();
+    return pollers;
+}
+
+void PlatformHelper::init_udp_peer(const std::shared_ptr<SipServer> &server) {
+    udp_peer_ = std::make_shared<SipUdpPeer>(server);
+}
+
+void PlatformHelper::bind_poller(const std::shared_ptr<SipServer> &server, const std::string &platform_id) {
+    if (!server->get_account().platform_poller_affinity) {
+        return;
+    }
+    auto &pollers = affinity_pollers();
+    if (pollers.empty()) {
+        return;
+    }
+    DeviceCode code;
+    auto hash = DeviceCode::parse(platform_id, code) ? code.hash() : std::hash<std::string>()(platform_id);
+    poller_ = pollers[hash % pollers.size()];
+}
+
+EventPoller::Ptr PlatformHelper::get_poller() const {
+    return poller_ ? poller_ : EventPollerPool::Instance().getPoller();
+}
+
 PlatformHelper::~PlatformHelper() {
     if (tcp_session_) {
         tcp_session_->safeShutdown();
@@ -67,42 +102,36 @@ PlatformHelper::~PlatformHelper() {
 void PlatformHelper::get_session(
     const std::function<void(const toolkit::SockException &, std::shared_ptr<SipSession>)> &cb, bool force_tcp) {
     bool is_udp = !force_tcp && (get_transport() == TransportType::udp || get_transport() == TransportType::both);
-    if (!is_udp && tcp_session_) {
+    if (poller_ && !poller_->isCurrentThread()) {
+        // 切换到平台绑定的 poller, 同一平台的发送都在该线程执行
+        poller_->async([cb, force_tcp, weak_this = weak_from_this()]() {
+            if (auto this_ptr = weak_this.lock()) {
+                return this_ptr->get_session(cb, force_tcp);
+            }
+            cb(toolkit::SockException(toolkit::Err_other, "platform destroyed"), nullptr);
+        });
+        return;
+    }
+    if (!is_udp && tcp_session_ && tcp_session_->is_alive()) {
         return cb({}, tcp_session_);
     }
-    auto poller = toolkit::EventPollerPool::Instance().getPoller();
+    auto poller = get_poller();
     if (auto server = local_server_weak_.lock()) {
         if (is_udp) {
-            std::shared_ptr<SipSession> session_ptr;
-            {
-                std::lock_guard<decltype(udp_sip_session_map_mutex_)> lock(udp_sip_session_map_mutex_);
-                if (auto it = udp_sip_session_map_.find(poller.get()); it != udp_sip_session_map_.end()) {
-                    session_ptr = it->second;
-                } else {
-                    if (server->udp_server_sockets().size() == 1) {
-                        session_ptr = std::make_shared<SipSession>(server->udp_server_sockets().begin()->second);
-                        udp_sip_session_map_[poller.get()] = session_ptr;
-                    } else {
-                        session_ptr = std::make_shared<SipSession>(server->udp_server_sockets().at(poller.get()));
-                        udp_sip_session_map_[poller.get()] = session_ptr;
-                    }
-                    if (session_ptr) {
-                        if (remote_addr_.ss_family == AF_INET || remote_addr_.ss_family == AF_INET6) {
-                            session_ptr->set_peer(remote_addr_);
-                        } else {
-                            // 此处只能设置IP地址， 如果是域名 一定会失败
-                            try {
-                                session_ptr->set_peer(sip_account().host, sip_account().port);
-                            } catch (const std::exception &e) {
-                                ErrorL << "Exception in set_peer(" << sip_account().host << ":" << sip_account().port <<  "): " << e.what();
-                            }
-                        }
-                        session_ptr->set_local_ip(sip_account().local_host);
-                        session_ptr->set_local_port(sip_account().local_port);
+            auto session_ptr = server->udp_send_session(poller.get());
+            if (session_ptr) {
+                struct sockaddr_storage addr {};
+                if (!udp_peer_->get_addr(addr)) {
+                    // 此处只能设置IP地址， 如果是域名 一定会失败
+                    try {
+                        addr = SockUtil::make_sockaddr(sip_account().host.c_str(), sip_account().port);
+                        udp_peer_->set_addr(addr);
+                    } catch (const std::exception &e) {
+                        ErrorL << "Exception in set_peer(" << sip_account().host << ":" << sip_account().port <<  "): " << e.what();
                     }
                 }
+                udp_peer_->set_local_ip(sip_account().local_host);
             }
-
             return cb(
                 session_ptr ? SockException() : SockException(toolkit::Err_other, "not found sip udp socket"),
                 session_ptr);
@@ -178,7 +207,7 @@ bool PlatformHelper::update_remote_via(std::pair<std::string, uint32_t> val) {
             tcp_session_->set_local_port(port);
         }
         // 通知上层应用？
-        toolkit::EventPollerPool::Instance().getExecutor()->async(
+        get_poller()->async(
             [this_ptr = shared_from_this()]() {
                 if (auto platform = std::dynamic_pointer_cast<SuperPlatformImpl>(this_ptr)) {
                     NOTICE_EMIT(
@@ -213,23 +242,57 @@ std::string PlatformHelper::get_contact_uri() {
 }
 
 void PlatformHelper::on_platform_addr_changed(struct sockaddr_storage &addr) {
-    bool flag = ((addr.ss_family == AF_INET || addr.ss_family == AF_INET6)) && !areAddressesEqual(remote_addr_, addr);
-    if (flag) {
+    // 地址只保存在 udp 发送目标中, 发送时由共享的发送 session 纠正 ipv4 与 ipv6
+    if (udp_peer_->set_addr(addr)) {
         DebugL << "change platform address " << SockUtil::inet_ntoa((sockaddr *)&addr);
-        memcpy(&remote_addr_, &addr, sizeof(struct sockaddr_storage));
-        std::lock_guard<decltype(udp_sip_session_map_mutex_)> lock(udp_sip_session_map_mutex_);
-        for (auto &it : udp_sip_session_map_) {
-            it.second->set_peer(addr); // 这个函数会自动纠正ipv4 与 ipv6
-        }
     }
 }
 void PlatformHelper::add_request_proxy(int32_t sn, const std::shared_ptr<RequestProxyImpl> &proxy) {
-    std::unique_lock<decltype(request_map_mutex_)> lck(request_map_mutex_);
-    request_map_[sn] = proxy;
+    if (!poller_) {
+        std::unique_lock<decltype(request_map_mutex_)> lck(request_map_mutex_);
+        request_map_[sn] = proxy;
+        return;
+    }
+    if (poller_->isCurrentThread()) {
+        request_map_[sn] = proxy;
+        return;
+    }
+    // 请求的发送同样切换到 poller_ 执行, 在此之前投递, 应答到达时一定已经加入
+    poller_->async([weak_this = weak_from_this(), sn, proxy]() {
+        if (auto this_ptr = weak_this.lock()) {
+            this_ptr->request_map_[sn] = proxy;
+        }
+    });
 }
 void PlatformHelper::remove_request_proxy(int32_t sn) {
-    std::unique_lock<decltype(request_map_mutex_)> lck(request_map_mutex_);
-    request_map_.erase(sn);
+    if (!poller_) {
+        std::unique_lock<decltype(request_map_mutex_)> lck(request_map_mutex_);
+        request_map_.erase(sn);
+        return;
+    }
+    if (poller_->isCurrentThread()) {
+        request_map_.erase(sn);
+        return;
+    }
+    poller_->async([weak_this = weak_from_this(), sn]() {
+        if (auto this_ptr = weak_this.lock()) {
+            this_ptr->request_map_.erase(sn);
+        }
+    });
+}
+
+// 复用监听 socket 的 udp session 由平台的发送目标指定对端地址, 其余 session 直接发送
+static int send_transaction(
+    const std::shared_ptr<sip_uac_transaction_t> &transaction, const std::string &payload,
+    const std::shared_ptr<SipSession> &session, const std::shared_ptr<SipUdpPeer> &peer) {
+    if (session->is_unbound()) {
+        return sip_uac_send(
+            transaction.get(), payload.data(), static_cast<int>(payload.size()), SipUdpPeer::get_transport(),
+            peer.get());
+    }
+    return sip_uac_send(
+        transaction.get(), payload.data(), static_cast<int>(payload.size()), SipSession::get_transport(),
+        session.get());
 }
 
 void PlatformHelper::uac_send(
@@ -238,7 +301,7 @@ void PlatformHelper::uac_send(
     set_message_contact(transaction.get(), get_contact_uri().c_str());
     set_message_header(transaction.get());
     get_session(
-        [transaction, payload = std::move(payload), weak_this = weak_from_this(),
+        [transaction, payload = std::move(payload), peer = udp_peer_,
          rcb](const toolkit::SockException &e, const std::shared_ptr<SipSession> &session) {
             if (e) {
                 return rcb(false, e.what());
@@ -246,10 +309,7 @@ void PlatformHelper::uac_send(
             if (!session) {
                 return rcb(false, "got session failed");
             }
-            if (0
-                != sip_uac_send(
-                    transaction.get(), payload.data(), static_cast<int>(payload.size()), SipSession::get_transport(),
-                    session.get())) {
+            if (0 != send_transaction(transaction, payload, session, peer)) {
                 return rcb(false, "failed to send request, call sip_uac_send failed");
             }
             rcb(true, {});
@@ -262,7 +322,7 @@ void PlatformHelper::uac_send2(
     set_message_contact(transaction.get(), get_contact_uri().c_str());
     set_message_header(transaction.get());
     get_session(
-        [transaction, payload = std::move(payload), weak_this = weak_from_this(),
+        [transaction, payload = std::move(payload), peer = udp_peer_,
          rcb](const toolkit::SockException &e, const std::shared_ptr<SipSession> &session) {
             if (e) {
                 return rcb(false, e.what(), session);
@@ -270,10 +330,7 @@ void PlatformHelper::uac_send2(
             if (!session) {
                 return rcb(false, "got session failed", nullptr);
             }
-            if (0
-                != sip_uac_send(
-                    transaction.get(), payload.data(), static_cast<int>(payload.size()), SipSession::get_transport(),
-                    session.get())) {
+            if (0 != send_transaction(transaction, payload, session, peer)) {
                 return rcb(false, "failed to send request, call sip_uac_send failed", session);
             }
             rcb(true, {}, session);
@@ -287,6 +344,7 @@ void PlatformHelper::uac_send3(
     struct uac_context {
         SipReplyCallback rcb; // 结果回调函数
         std::shared_ptr<SipSession> session; // 加一层保险， 避免session 中途被释放
+        std::shared_ptr<SipUdpPeer> peer; // udp 重传时使用的发送目标
         std::shared_ptr<sip_uac_transaction_t> transaction;
     };
     static auto adapter = [](void* param, const struct sip_message_t* reply, struct sip_uac_transaction_t* t, int code) -> int {
@@ -307,7 +365,7 @@ void PlatformHelper::uac_send3(
     set_message_header(transaction.get());
 
     get_session(
-    [transaction, payload = std::move(payload), weak_this = weak_from_this(),rcb = std::move(rcb),ecb](const toolkit::SockException &e, const std::shared_ptr<SipSession> &session) {
+    [transaction, payload = std::move(payload), peer = udp_peer_, rcb = std::move(rcb), ecb](const toolkit::SockException &e, const std::shared_ptr<SipSession> &session) {
         if (e) {
             return ecb(false, e.what());
         }
@@ -317,15 +375,14 @@ void PlatformHelper::uac_send3(
         auto context = new uac_context();
         context->rcb = rcb;
         context->session = session;
+        context->peer = peer;
         context->transaction = transaction;
         transaction->onreply = adapter;
         transaction->param = context;
 
 
         // todo: 采用自定义状态码， 来明确处理错误信息
-        int ret = sip_uac_send(
-                transaction.get(), payload.data(), static_cast<int>(payload.size()), SipSession::get_transport(),
-                session.get());
+        int ret = send_transaction(transaction, payload, session, peer);
         if(ret != 0) {
             delete context; // 发送失败，清理资源
             ecb(false, "failed to send request, call sip_uac_send failed");
@@ -350,18 +407,42 @@ void PlatformHelper::set_tcp_session(const std::shared_ptr<SipSession> &session)
 }
 void PlatformHelper::set_platform_status_cb(void *user_data, std::function<void(PlatformStatusType)> cb) {
     std::lock_guard<decltype(status_cbs_mtx_)> lck(status_cbs_mtx_);
-    status_cbs_[user_data] = std::move(cb);
+    auto &item = status_cbs_[user_data];
+    item.gen = ++status_cb_gen_;
+    item.cb = std::make_shared<std::function<void(PlatformStatusType)>>(std::move(cb));
 }
 void PlatformHelper::remove_platform_status_cb(void *user_data) {
+    // 不等待 poller, 只删除登记; 通知时按代数确认回调仍然有效
     std::lock_guard<decltype(status_cbs_mtx_)> lck(status_cbs_mtx_);
-    status_cbs_.erase(&user_data);
+    status_cbs_.erase(user_data);
+}
+void PlatformHelper::emit_platform_status(PlatformStatusType status) {
+    std::vector<std::pair<void *, StatusCb>> cbs;
+    {
+        std::lock_guard<decltype(status_cbs_mtx_)> lck(status_cbs_mtx_);
+        cbs.assign(status_cbs_.begin(), status_cbs_.end());
+    }
+    // 在锁外调用, 回调中可以添加、移除回调; 调用前再次确认没有被移除或替换
+    for (auto &it : cbs) {
+        {
+            std::lock_guard<decltype(status_cbs_mtx_)> lck(status_cbs_mtx_);
+            auto cur = status_cbs_.find(it.first);
+            if (cur == status_cbs_.end() || cur->second.gen != it.second.gen) {
+                continue;
+            }
+        }
+        (*it.second.cb)(status);
+    }
 }
 
 int PlatformHelper::on_response(
     MessageBase &&message, std::shared_ptr<sip_uas_transaction_t> transaction, std::shared_ptr<sip_message_t> request) {
     std::shared_ptr<RequestProxyImpl> proxy;
     {
-        std::shared_lock<decltype(request_map_mutex_)> lock_guard(request_map_mutex_);
+        std::shared_lock<decltype(request_map_mutex_)> lock_guard(request_map_mutex_, std::defer_lock);
+        if (!poller_) {
+            lock_guard.lock();
+        }
         auto it = request_map_.find(message.sn());
         if (it != request_map_.end()) {
             proxy = it->second;
@@ -396,6 +477,36 @@ int PlatformHelper::on_recv_message(
         return sip_uas_reply(transaction.get(), 503, nullptr, 0, session.get());
     }
 
+    // 心跳快速路径, 直接从负载中识别心跳, 不构建 xml DOM;
+    // 有心跳回调或广播时需要完整的消息, 仍走下面的完整解析流程
+    if (KeepaliveScanner::Result keepalive;
+        KeepaliveScanner::scan((const char *)req->payload, req->size, keepalive)) {
+        auto platform
+            = std::dynamic_pointer_cast<SubordinatePlatformImpl>(sip_server->get_subordinate_platform(platform_id));
+        if (!platform) {
+            WarnL << "platform was not found";
+            return 0;
+        }
+        if (!platform->keepalive_observed()) {
+            struct sockaddr_storage addr {};
+            if (session->get_peer_addr(addr)) {
+                platform->on_platform_addr_changed(addr);
+            }
+            // 与完整解析流程一致, 平台字符集未知时使用报文声明的字符集
+            if (!keepalive.declaration.empty() && platform->get_encoding() == CharEncodingType::invalid) {
+                auto encoding = getCharEncodingType(std::string(keepalive.declaration).c_str());
+                if (encoding != CharEncodingType::invalid) {
+                    platform->set_encoding(encoding);
+                }
+            }
+            auto sip_code = platform->refresh_keepalive();
+            if (sip_code > 0) {
+                return sip_uas_reply(transaction.get(), sip_code, nullptr, 0, session.get());
+            }
+            return 0;
+        }
+    }
+
     auto xml_ptr = std::make_shared<tinyxml2::XMLDocument>();
     if (xml_ptr->Parse((const char *)req->payload, req->size) != tinyxml2::XML_SUCCESS) {
         WarnL << "XML parse error (" << xml_ptr->ErrorID() << ":" << xml_ptr->ErrorName() << ")" << xml_ptr->ErrorStr()
@@ -441,7 +552,7 @@ int PlatformHelper::on_recv_message(
         if (platform_) {
             // 更新来源地址, 方便向下级平台发送消息
             struct sockaddr_storage addr {};
-            if (SockUtil::get_sock_peer_addr(session->getSock()->rawFD(), addr)) {
+            if (session->get_peer_addr(addr)) {
                 platform_->on_platform_addr_changed(addr);
             }
         }
@@ -456,10 +567,10 @@ int PlatformHelper::on_recv_message(
     }
     CharEncodingType message_encoding { message.encoding() };
     if (message_encoding == CharEncodingType::invalid) {
-        message_encoding = platform_->sip_account().encoding;
+        message_encoding = platform_->get_encoding();
         message.encoding(message_encoding);
-    } else if (platform_->sip_account().encoding == CharEncodingType::invalid) {
-        platform_->sip_account().encoding = message_encoding;
+    } else if (platform_->get_encoding() == CharEncodingType::invalid) {
+        platform_->set_encoding(message_encoding);
     }
     // [fold] endregion get platform
     std::string convert_xml_str;
@@ -487,13 +598,30 @@ int PlatformHelper::on_recv_message(
 
     DebugL << "handle message " << message;
 
+    if (platform_->poller_ && !platform_->poller_->isCurrentThread()) {
+        // 开启 poller 亲和时平台的消息都在绑定的 poller 处理, 事务可在任意线程回复;
+        // 请求报文在本函数返回后即被销毁, 不再传递
+        auto message_ptr = std::make_shared<MessageBase>(std::move(message));
+        platform_->poller_->async(
+            [platform_, message_ptr, transaction, session]() {
+                platform_->dispatch_message(std::move(*message_ptr), transaction, nullptr, session);
+            },
+            false);
+        return 0;
+    }
+    return platform_->dispatch_message(std::move(message), transaction, req, session);
+}
+
+int PlatformHelper::dispatch_message(
+    MessageBase &&message, const std::shared_ptr<sip_uas_transaction_t> &transaction,
+    const std::shared_ptr<sip_message_t> &req, const std::shared_ptr<SipSession> &session) {
     // 如果是应答消息，一定来自下级平台
     int sip_code = 0;
     switch (message.root()) {
-        case MessageRootType::Query: sip_code = platform_->on_query(std::move(message), transaction, req); break;
-        case MessageRootType::Control: sip_code = platform_->on_control(std::move(message), transaction, req); break;
-        case MessageRootType::Notify: sip_code = platform_->on_notify(std::move(message), transaction, req); break;
-        case MessageRootType::Response: sip_code = platform_->on_response(std::move(message), transaction, req); break;
+        case MessageRootType::Query: sip_code = on_query(std::move(message), transaction, req); break;
+        case MessageRootType::Control: sip_code = on_control(std::move(message), transaction, req); break;
+        case MessageRootType::Notify: sip_code = on_notify(std::move(message), transaction, req); break;
+        case MessageRootType::Response: sip_code = on_response(std::move(message), transaction, req); break;
         default: break;
     }
     if (sip_code > 0) {
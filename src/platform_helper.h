@@ -38,6 +38,7 @@ class MessageBase;
 class RequestProxyImpl;
 class SipServer;
 class SipSession;
+class SipUdpPeer;
 class PlatformHelper : public std::enable_shared_from_this<PlatformHelper> {
 public:
     // 发送sip请求的结果回调
@@ -48,6 +49,7 @@ public:
     virtual TransportType get_transport() const = 0;
 
     virtual CharEncodingType get_encoding() const = 0;
+    virtual void set_encoding(CharEncodingType encoding) = 0;
 
     struct sip_agent_t * get_sip_agent();
 
@@ -72,6 +74,10 @@ public:
     */
     void on_platform_addr_changed(struct sockaddr_storage& addr);
 
+    /**
+     * 记录等待应答的请求, 可在任意线程调用
+     * @remark 开启 poller 亲和时请求表只在平台绑定的 poller 访问, 不加锁
+     */
     void add_request_proxy(int32_t sn, const std::shared_ptr<RequestProxyImpl> &proxy);
     void remove_request_proxy(int32_t sn);
     int on_response(MessageBase &&message, std::shared_ptr<sip_uas_transaction_t> transaction, std::shared_ptr<sip_message_t> request);
@@ -80,6 +86,14 @@ public:
     const std::shared_ptr<SipSession> &session, const std ::shared_ptr<sip_uas_transaction_t> &transaction,
     const std ::shared_ptr<sip_message_t> &req, void *dialog_ptr);
 
+    /**
+     * 按消息根节点分发并回复
+     * @param req 请求报文, 切换到平台绑定的 poller 处理时为空
+     */
+    int dispatch_message(
+        MessageBase &&message, const std::shared_ptr<sip_uas_transaction_t> &transaction,
+        const std::shared_ptr<sip_message_t> &req, const std::shared_ptr<SipSession> &session);
+
     virtual int on_notify(MessageBase &&message, std::shared_ptr<sip_uas_transaction_t> transaction, std::shared_ptr<sip_message_t> request);
     virtual int on_query(MessageBase &&message, std::shared_ptr<sip_uas_transaction_t> transaction, std::shared_ptr<sip_message_t> request);
     virtual int on_control(MessageBase &&message, std::shared_ptr<sip_uas_transaction_t> transaction, std::shared_ptr<sip_message_t> request);
@@ -96,8 +110,32 @@ public:
 
     void set_tcp_session(const std::shared_ptr<SipSession> &session);
 
+    /**
+     * 添加、移除平台在线状态回调, 可在任意线程调用, 不等待 poller;
+     * 移除返回后不会再开始新的调用, 但 poller 中正在执行的调用可能仍未结束, 回调不应直接访问 user_data
+     */
     void set_platform_status_cb(void * user_data, std::function<void(PlatformStatusType)> cb);
     void remove_platform_status_cb(void * user_data);
+    /**
+     * 通知平台在线状态回调, 在 get_poller() 中调用
+     */
+    void emit_platform_status(PlatformStatusType status);
+
+    /**
+     * 获取平台的执行 poller
+     * @remark 开启 poller 亲和时始终返回平台绑定的 poller, 否则每次从 poller 池中选取
+     */
+    std::shared_ptr<toolkit::EventPoller> get_poller() const;
+
+protected:
+    /**
+     * 创建 udp 发送目标, 在派生类构造时调用
+     */
+    void init_udp_peer(const std::shared_ptr<SipServer> &server);
+    /**
+     * 按平台编码哈希绑定 poller, 未开启 poller 亲和时不绑定
+     */
+    void bind_poller(const std::shared_ptr<SipServer> &server, const std::string &platform_id);
 
 private:
     void get_session(
@@ -112,18 +150,24 @@ protected:
     std::string from_uri_;
     // 发送消息时 目标uri
     std::string to_uri_;
-    // 存储等待应答的请求
+    // 存储等待应答的请求, 开启 poller 亲和时只在 poller_ 访问, 不使用锁
     std::unordered_map<int32_t, std::shared_ptr<RequestProxyImpl>> request_map_;
     std::shared_mutex request_map_mutex_;
-    // 专门用来发送sip消息的 session, 采用udp server 监听的socket封装，内部不绑定对端地址, 仅仅复用监听sock 发送数据
-    std::unordered_map<toolkit::EventPoller*, std::shared_ptr<SipSession>> udp_sip_session_map_;
-    std::recursive_mutex udp_sip_session_map_mutex_;
+    // udp 发送目标, 发送 session 由服务按 poller 共享, 平台只保存对端地址
+    std::shared_ptr<SipUdpPeer> udp_peer_;
     // 联系地址
     std::string contact_uri_;
-    struct sockaddr_storage remote_addr_{};
+    // 平台在线状态回调, 每次添加分配新的代数; 通知在锁外调用, 调用前按代数确认回调没有被移除或替换
+    struct StatusCb {
+        uint64_t gen { 0 };
+        std::shared_ptr<std::function<void(PlatformStatusType)>> cb;
+    };
     std::mutex status_cbs_mtx_;
-    std::unordered_map<void*, std::function<void(PlatformStatusType)>> status_cbs_; // 平台在线状态回到
+    std::unordered_map<void*, StatusCb> status_cbs_;
+    uint64_t status_cb_gen_ { 0 };
     std::atomic_int32_t platform_sn_ { 1 };
+    // 平台绑定的 poller, 为空时未开启 poller 亲和
+    std::shared_ptr<toolkit::EventPoller> poller_;
 };
 } // namespace gb28181
 
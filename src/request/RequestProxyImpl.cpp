@@ -166,7 +166,7 @@ void RequestProxyImpl::on_reply(const std::shared_ptr<sip_message_t> &sip_messag
             }
             return false;
         },
-        toolkit::EventPollerPool::Instance().getPoller());
+        platform_->get_poller());
 }
 void RequestProxyImpl::on_completed() {
     if (!result_flag_.test_and_set()) {
@@ -239,7 +239,7 @@ int RequestProxyImpl::on_response(const std::shared_ptr<MessageBase> &response)
         code = response_callback_(shared_from_this(), response, completed);
     }
     if (completed) {
-        toolkit::EventPollerPool::Instance().getPoller()->async(
+        platform_->get_poller()->async(
             [this_ptr = shared_from_this()]() { this_ptr->on_completed(); }, false);
     }
     return code ? code : 400;
@@ -300,7 +300,7 @@ int RequestProxyImpl::on_response(
         error_ = "load_from_xml failed, error = " + response->get_error();
         WarnL << error_;
         // 这里放入异步， 避免 on_completed 阻塞
-        toolkit::EventPollerPool::Instance().getPoller()->async(
+        platform_->get_poller()->async(
             [this_ptr = shared_from_this()]() { this_ptr->on_completed(); }, false);
         return 400;
     }
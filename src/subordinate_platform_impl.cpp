@@ -26,6 +26,8 @@
 #include <request/RequestProxyImpl.h>
 #include <sip-transport.h>
 #include <sip-uas.h>
+#include <algorithm>
+#include <cstring>
 
 using namespace gb28181;
 using namespace toolkit;
@@ -43,6 +45,8 @@ SubordinatePlatformImpl::SubordinatePlatformImpl(subordinate_account account, co
         account_.local_port = server_account.local_port;
     }
     local_server_weak_ = server;
+    init_udp_peer(server);
+    bind_poller(server, account_.platform_id);
     from_uri_ = "sip:" + server_account.platform_id + "@" + server_account.local_host + ":"
         + std::to_string(server_account.local_port);
     contact_uri_
@@ -59,6 +63,20 @@ SubordinatePlatformImpl::SubordinatePlatformImpl(subordinate_account account, co
 }
 
 SubordinatePlatformImpl::~SubordinatePlatformImpl() {}
+
+// 注册风暴控制: 超出速率时回复 503 并附带错开的 Retry-After
+static bool defer_register(
+    SipServer &server, const std::shared_ptr<sip_uas_transaction_t> &transaction,
+    const std::shared_ptr<SipSession> &session, int &ret) {
+    uint32_t retry_after = 0;
+    if (server.register_governor().admit(retry_after)) {
+        return false;
+    }
+    set_message_retry_after(transaction.get(), retry_after);
+    ret = sip_uas_reply(transaction.get(), 503, nullptr, 0, session.get());
+    return true;
+}
+
 int SubordinatePlatformImpl::on_recv_register(
     const std::shared_ptr<SipSession> &session, const std::shared_ptr<sip_uas_transaction_t> &transaction,
     const std::shared_ptr<sip_message_t> &req, const std::string &user, const std::string &location, int expires) {
@@ -79,9 +97,14 @@ int SubordinatePlatformImpl::on_recv_register(
         }
         auto &account = platform->account();
         if (account.auth_type == SipAuthType::none || verify_authorization(req.get(), user, account.password)) {
+            // 已在线平台的注册刷新不受限制
+            if (int ret = 0; account.plat_status.status != PlatformStatusType::online
+                && defer_register(*sip_server, transaction, session, ret)) {
+                return ret;
+            }
             platform->account_.host = session->get_peer_ip();
             platform->account_.port = session->get_peer_port();
-            if (struct sockaddr_storage addr {}; SockUtil::get_sock_peer_addr(session->getSock()->rawFD(), addr)) {
+            if (struct sockaddr_storage addr {}; session->get_peer_addr(addr)) {
                 platform->on_platform_addr_changed(addr);
             }
             platform->set_status(PlatformStatusType::online, {});
@@ -99,6 +122,9 @@ int SubordinatePlatformImpl::on_recv_register(
         const auto &server_account = sip_server->get_account();
         if (server_account.auth_type == SipAuthType::none
             || verify_authorization(req.get(), user, server_account.password)) {
+            if (int ret = 0; defer_register(*sip_server, transaction, session, ret)) {
+                return ret;
+            }
             // 构建一个新的平台
             subordinate_account account;
             account.name = user;
@@ -127,7 +153,7 @@ int SubordinatePlatformImpl::on_recv_register(
                         if (session->getSock() && session->getSock()->sockType() == SockNum::SockType::Sock_TCP) {
                             platform->set_tcp_session(session);
                         }
-                        if (struct sockaddr_storage addr {}; SockUtil::get_sock_peer_addr(session->getSock()->rawFD(), addr)) {
+                        if (struct sockaddr_storage addr {}; session->get_peer_addr(addr)) {
                             platform->on_platform_addr_changed(addr);
                         }
                         platform->set_status(PlatformStatusType::online, {});
@@ -146,6 +172,7 @@ int SubordinatePlatformImpl::on_recv_register(
 }
 
 void SubordinatePlatformImpl::shutdown() {
+    unwatch_keepalive();
     NOTICE_EMIT(
         kEventOnSubordinatePlatformShutdownArgs, Broadcast::kEventOnSubordinatePlatformShutdown,
         std::dynamic_pointer_cast<SubordinatePlatform>(shared_from_this()));
@@ -157,43 +184,28 @@ std::shared_ptr<LocalServer> SubordinatePlatformImpl::get_local_server() const {
 void SubordinatePlatformImpl::set_status(PlatformStatusType status, std::string error) {
     // 当为伪装在线时， 下次状态变更不论是否在线都需要广播
 
-    bool status_changed = status != account_.plat_status.status;
-    account_.plat_status.status = status;
-    account_.plat_status.error = std::move(error);
-    camouflage_online_ = false;
+    bool status_changed = false;
+    {
+        std::lock_guard<std::mutex> lck(state_mtx_);
+        status_changed = status != account_.plat_status.status;
+        account_.plat_status.status = status;
+        account_.plat_status.error = error;
+        camouflage_online_ = false;
+        if (status == PlatformStatusType::online) {
+            account_.plat_status.register_time = getCurrentMicrosecond(true);
+        } else {
+            account_.plat_status.offline_time = getCurrentMicrosecond(false);
+        }
+    }
     if (status == PlatformStatusType::online) {
-        account_.plat_status.register_time = getCurrentMicrosecond(true);
-        // 设置心跳定时器
-        keepalive_timer_ = std::make_shared<toolkit::Timer>(
-        5,
-        [weak_this = weak_from_this()]() {
-            if (auto this_ptr = weak_this.lock()) {
-                auto last_time = ((std::max)(
-                    this_ptr->account_.plat_status.register_time, this_ptr->account_.plat_status.keepalive_time));
-                auto now_time = toolkit::getCurrentMicrosecond(true);
-                if (last_time + 3 * 30 * 1000000L <= now_time) {
-                    this_ptr->set_status(PlatformStatusType::offline, "keepalive timeout");
-                }
-                return true;
-            }
-            return false;
-        },
-        nullptr);
-    } else {
-        // 离线取消心跳定时器
-        account_.plat_status.offline_time = getCurrentMicrosecond(false);
-        keepalive_timer_.reset();
+        // 加入心跳超时检测, 离线后在下次检测时移除
+        watch_keepalive();
     }
 
     // 异步广播平台在线状态
-    EventPollerPool::Instance().getPoller()->async(
+    get_poller()->async(
         [this_ptr = shared_from_this(), status, error, status_changed]() {
-            {
-                std::lock_guard<decltype(status_cbs_mtx_)> lck(this_ptr->status_cbs_mtx_);
-                for (auto &it : this_ptr->status_cbs_) {
-                    it.second(status);
-                }
-            }
+            this_ptr->emit_platform_status(status);
             NOTICE_EMIT(
                 kEventSubordinatePlatformStatusArgs, Broadcast::kEventSubordinatePlatformStatus,
                 std::dynamic_pointer_cast<SubordinatePlatform>(this_ptr), status, error, status_changed);
@@ -203,22 +215,45 @@ void SubordinatePlatformImpl::set_status(PlatformStatusType status, std::string
 
 int SubordinatePlatformImpl::on_keep_alive(std::shared_ptr<KeepaliveMessageRequest> request) {
 
-    if (account_.plat_status.status != PlatformStatusType::online) {
-        return 0;
+    {
+        std::lock_guard<std::mutex> lck(state_mtx_);
+        if (account_.plat_status.status != PlatformStatusType::online) {
+            return 0;
+        }
+        account_.plat_status.keepalive_time = toolkit::getCurrentMicrosecond(true);
     }
-    account_.plat_status.keepalive_time = toolkit::getCurrentMicrosecond(true);
     if (on_keep_alive_callback_) {
-        toolkit::EventPollerPool::Instance().getPoller()->async(
+        get_poller()->async(
             [this_ptr = shared_from_this(), request = std::move(request)]() {
                 this_ptr->on_keep_alive_callback_(this_ptr, request);
             });
     }
     // 广播通知心跳消息
-    toolkit::EventPollerPool::Instance().getPoller()->async([this_ptr = shared_from_this(), request]() {
-        NOTICE_EMIT(
-            kEventSubKeepaliveArgs, Broadcast::kEventSubKeepalive,
-            std::dynamic_pointer_cast<SubordinatePlatform>(this_ptr), request);
-    });
+    auto server = get_sip_server();
+    if (server && server->get_account().keepalive_event) {
+        get_poller()->async([this_ptr = shared_from_this(), request]() {
+            NOTICE_EMIT(
+                kEventSubKeepaliveArgs, Broadcast::kEventSubKeepalive,
+                std::dynamic_pointer_cast<SubordinatePlatform>(this_ptr), request);
+        });
+    }
+    return 200;
+}
+
+bool SubordinatePlatformImpl::keepalive_observed() {
+    if (on_keep_alive_callback_) {
+        return true;
+    }
+    auto server = get_sip_server();
+    return server && server->get_account().keepalive_event;
+}
+
+int SubordinatePlatformImpl::refresh_keepalive() {
+    std::lock_guard<std::mutex> lck(state_mtx_);
+    if (account_.plat_status.status != PlatformStatusType::online) {
+        return 0;
+    }
+    account_.plat_status.keepalive_time = toolkit::getCurrentMicrosecond(true);
     return 200;
 }
 
@@ -234,7 +269,7 @@ int SubordinatePlatformImpl::on_notify(
         case MessageCmdType::Alarm: {
             auto alarm_ptr = std::make_shared<AlarmNotifyMessage>(std::move(message));
             alarm_ptr->load_from_xml();
-            toolkit::EventPollerPool::Instance().getPoller()->async(
+            get_poller()->async(
                 [alarm_ptr, this_ptr = shared_from_this()]() {
                     // 广播通知
                     NOTICE_EMIT(
@@ -253,7 +288,7 @@ int SubordinatePlatformImpl::on_notify(
             DebugL << "on catalog";
             auto notify = std::make_shared<CatalogNotifyMessage>(std::move(message));
             notify->load_from_xml();
-            toolkit::EventPollerPool::Instance().getPoller()->async(
+            get_poller()->async(
                 [this_ptr = shared_from_this(), notify] {
                     NOTICE_EMIT(
                         kEventSubordinateNotifyCatalogArgs, Broadcast::kEventSubordinateNotifyCatalog,
@@ -265,7 +300,7 @@ int SubordinatePlatformImpl::on_notify(
         case MessageCmdType::MediaStatus: {
             auto notify = std::make_shared<MediaStatusNotifyMessage>(std::move(message));
             notify->load_from_xml();
-            toolkit::EventPollerPool::Instance().getPoller()->async(
+            get_poller()->async(
                 [this_ptr = shared_from_this(), notify] {
                     NOTICE_EMIT(
                         kEventSubordinateNotifyMediaStatusArgs, Broadcast::kEventSubordinateNotifyMediaStatus,
@@ -277,7 +312,7 @@ int SubordinatePlatformImpl::on_notify(
         case MessageCmdType::MobilePosition: {
             auto notify = std::make_shared<MobilePositionNotifyMessage>(std::move(message));
             notify->load_from_xml();
-            toolkit::EventPollerPool::Instance().getPoller()->async(
+            get_poller()->async(
                 [this_ptr = shared_from_this(), notify] {
                     NOTICE_EMIT(
                         kEventSubordinateNotifyMobilePositionArgs, Broadcast::kEventSubordinateNotifyMobilePosition,
@@ -289,7 +324,7 @@ int SubordinatePlatformImpl::on_notify(
         case MessageCmdType::UploadSnapShotFinished: {
             auto notify = std::make_shared<UploadSnapShotFinishedNotifyMessage>(std::move(message));
             notify->load_from_xml();
-            toolkit::EventPollerPool::Instance().getPoller()->async(
+            get_poller()->async(
                 [this_ptr = shared_from_this(), notify] {
                     NOTICE_EMIT(
                         kEventSubordinateNotifyUploadSnapShotFinishedArgs,
@@ -302,7 +337,7 @@ int SubordinatePlatformImpl::on_notify(
         case MessageCmdType::VideoUploadNotify: {
             auto notify = std::make_shared<VideoUploadNotifyMessage>(std::move(message));
             notify->load_from_xml();
-            toolkit::EventPollerPool::Instance().getPoller()->async(
+            get_poller()->async(
                 [this_ptr = shared_from_this(), notify] {
                     NOTICE_EMIT(
                         kEventSubordinateNotifyVideoUploadNotifyArgs,
@@ -315,7 +350,7 @@ int SubordinatePlatformImpl::on_notify(
         case MessageCmdType::DeviceUpgradeResult: {
             auto notify = std::make_shared<DeviceUpgradeResultNotifyMessage>(std::move(message));
             notify->load_from_xml();
-            toolkit::EventPollerPool::Instance().getPoller()->async(
+            get_poller()->async(
                 [this_ptr = shared_from_this(), notify] {
                     NOTICE_EMIT(
                         kEventSubordinateNotifyDeviceUpgradeResultArgs,
@@ -489,27 +524,92 @@ SubordinatePlatformImpl::subscribe(const std::shared_ptr<MessageBase> &request,
     return SubscribeRequest::new_subscribe(shared_from_this(), request, std::move(info));
 }
 void SubordinatePlatformImpl::camouflage_online(uint64_t register_time, uint64_t keepalive_time) {
-    if (account_.plat_status.status == PlatformStatusType::online)
+    {
+        std::lock_guard<std::mutex> lck(state_mtx_);
+        if (account_.plat_status.status == PlatformStatusType::online)
+            return;
+        account_.plat_status.register_time = register_time;
+        account_.plat_status.keepalive_time = keepalive_time;
+        account_.plat_status.status = PlatformStatusType::online;
+        camouflage_online_ = true;
+    }
+    watch_keepalive();
+}
+
+void SubordinatePlatformImpl::watch_keepalive() {
+    if (account_.keepalive_timeout == 0 || keepalive_removed_ || keepalive_watched_.exchange(true)) {
         return;
-    account_.plat_status.register_time = register_time;
-    account_.plat_status.keepalive_time = keepalive_time;
-    account_.plat_status.status = PlatformStatusType::online;
-    camouflage_online_ = true;
-    keepalive_timer_ = std::make_shared<toolkit::Timer>(
-        5,
-        [weak_this = weak_from_this()]() {
-            if (auto this_ptr = weak_this.lock()) {
-                auto last_time = ((std::max)(
-                    this_ptr->account_.plat_status.register_time, this_ptr->account_.plat_status.keepalive_time));
-                auto now_time = toolkit::getCurrentMicrosecond(true);
-                if (last_time + 3 * 30 * 1000000L <= now_time) {
-                    this_ptr->set_status(PlatformStatusType::offline, "keepalive timeout");
-                }
-                return true;
-            }
-            return false;
-        },
-        nullptr);
+    }
+    if (auto server = get_sip_server()) {
+        server->keepalive_sweeper().add(shared_from_this());
+    } else {
+        keepalive_watched_ = false;
+    }
+}
+
+int64_t SubordinatePlatformImpl::keepalive_remain(uint64_t now_us) {
+    std::lock_guard<std::mutex> lck(state_mtx_);
+    if (account_.plat_status.status != PlatformStatusType::online || account_.keepalive_timeout == 0
+        || keepalive_removed_) {
+        keepalive_watched_ = false;
+        return -1;
+    }
+    auto last_time = (std::max)(account_.plat_status.register_time, account_.plat_status.keepalive_time);
+    auto deadline = last_time + account_.keepalive_timeout * 1000000ull;
+    if (deadline <= now_us) {
+        keepalive_watched_ = false;
+        return 0;
+    }
+    return static_cast<int64_t>((deadline - now_us + 999) / 1000);
+}
+
+void SubordinatePlatformImpl::unwatch_keepalive() {
+    if (keepalive_removed_.exchange(true)) {
+        return;
+    }
+    if (auto server = get_sip_server()) {
+        server->keepalive_sweeper().remove(this);
+    }
+}
+
+bool SubordinatePlatformImpl::on_keepalive_timeout() {
+    // 从检测到投递执行期间可能收到了注册或心跳, 按当前时间重新确认
+    auto remain_ms = keepalive_remain(getCurrentMicrosecond(true));
+    if (remain_ms == 0) {
+        set_status(PlatformStatusType::offline, "keepalive timeout");
+        return true;
+    }
+    if (remain_ms > 0) {
+        // 检测之后重新注册, 继续检测
+        watch_keepalive();
+    }
+    return false;
+}
+
+void SubordinatePlatformImpl::get_snapshot_state(PlatformSnapshot::State &state) const {
+    // 在快照线程读取, 与状态变更使用同一把锁, 地址由 udp 发送目标加锁读取
+    {
+        std::lock_guard<std::mutex> lck(state_mtx_);
+        state.status = account_.plat_status.status;
+        state.encoding = account_.encoding;
+        state.register_time = account_.plat_status.register_time;
+        state.keepalive_time = account_.plat_status.keepalive_time;
+    }
+    if (!udp_peer_->get_addr(state.addr)) {
+        memset(&state.addr, 0, sizeof(state.addr));
+    }
+}
+
+void SubordinatePlatformImpl::restore_snapshot_state(const PlatformSnapshot::State &state) {
+    auto addr = state.addr;
+    on_platform_addr_changed(addr);
+    if (state.encoding != CharEncodingType::invalid) {
+        set_encoding(state.encoding);
+    }
+    if (state.status == PlatformStatusType::online) {
+        // 心跳时间从恢复时开始计算, 给设备一个心跳周期的时间证明仍然在线
+        camouflage_online(state.register_time, toolkit::getCurrentMicrosecond(true));
+    }
 }
 
 /**********************************************************************************************************
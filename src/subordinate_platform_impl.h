@@ -4,6 +4,7 @@
 #include "gb28181/subordinate_platform.h"
 #include "gb28181/type_define.h"
 #include "platform_helper.h"
+#include "inner/platform_snapshot.h"
 
 #include <functional>
 #include <memory>
@@ -25,10 +26,6 @@ class DeviceStatusMessageResponse;
 
 } // namespace gb28181
 
-namespace toolkit {
-class Timer;
-}
-
 namespace gb28181 {
 class SipSession;
 class LocalServer;
@@ -46,11 +43,17 @@ public:
 
     void shutdown() override;
 
-    void set_encoding(CharEncodingType encoding) override { account_.encoding = std::move(encoding); }
+    void set_encoding(CharEncodingType encoding) override {
+        std::lock_guard<std::mutex> lck(state_mtx_);
+        account_.encoding = encoding;
+    }
 
     std::shared_ptr<LocalServer> get_local_server() const override;
 
-    CharEncodingType get_encoding() const override { return account_.encoding; }
+    CharEncodingType get_encoding() const override {
+        std::lock_guard<std::mutex> lck(state_mtx_);
+        return account_.encoding;
+    }
 
     std::shared_ptr<SubordinatePlatformImpl> shared_from_this() {
         return std::dynamic_pointer_cast<SubordinatePlatformImpl>(PlatformHelper::shared_from_this());
@@ -72,6 +75,15 @@ public:
         std::function<void(std::shared_ptr<RequestProxy>)> rcb) override;
 
     int on_keep_alive(std::shared_ptr<KeepaliveMessageRequest> request);
+    /**
+     * 是否有心跳回调或心跳广播, 此时需要完整的心跳消息(包括 Info 中的故障设备列表)
+     */
+    bool keepalive_observed();
+    /**
+     * 心跳快速路径, 只更新心跳时间, 不构建消息对象; 无需通知时使用
+     * @return 需要回复的 sip 状态码, 不在线时为 0
+     */
+    int refresh_keepalive();
 
 
     int on_notify(
@@ -149,6 +161,34 @@ public:
 
     void camouflage_online(uint64_t register_time, uint64_t keepalive_time) override;
 
+    /**
+     * 平台状态快照, 用于重启后恢复
+     */
+    void get_snapshot_state(PlatformSnapshot::State &state) const;
+    void restore_snapshot_state(const PlatformSnapshot::State &state);
+
+    /**
+     * 心跳超时检测, 由 SipKeepaliveSweeper 调用
+     * @param now_us 当前系统时间(微秒)
+     * @return 距离超时的剩余毫秒数; 0 表示已超时, -1 表示已不在线或不检测, 均不再继续检测
+     */
+    int64_t keepalive_remain(uint64_t now_us);
+    /**
+     * 心跳超时下线, 由 SipKeepaliveSweeper 投递到平台的 poller 执行, 下线前再次确认检测之后没有收到新的注册
+     * @return 是否已下线
+     */
+    bool on_keepalive_timeout();
+
+private:
+    /**
+     * 平台上线后加入心跳超时检测
+     */
+    void watch_keepalive();
+    /**
+     * 平台关闭时移出心跳超时检测, 之后不再判定超时, 也不再广播离线
+     */
+    void unwatch_keepalive();
+
 private:
     bool camouflage_online_ = false; // 伪装在线
     TransportType get_transport() const override { return account_.transport_type; }
@@ -156,8 +196,10 @@ private:
 
 private:
     subordinate_account account_; // 账户信息
-    // 心跳检测
-    std::shared_ptr<toolkit::Timer> keepalive_timer_;
+    // 保护在线状态、注册/心跳时间与字符集的写入, 快照与心跳超时检测在后台线程读取这些字段
+    mutable std::mutex state_mtx_;
+    std::atomic_bool keepalive_watched_ { false }; // 已加入心跳超时检测
+    std::atomic_bool keepalive_removed_ { false }; // 已关闭, 不再检测
     std::function<void(std::shared_ptr<SubordinatePlatform>, std::shared_ptr<KeepaliveMessageRequest>)>
         on_keep_alive_callback_;
 };
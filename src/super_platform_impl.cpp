@@ -14,6 +14,7 @@
 #include "gb28181/message/record_info_message.h"
 #include "gb28181/message/sd_card_status_message.h"
 #include "gb28181/request/request_proxy.h"
+#include "inner/dns_cache.h"
 #include "inner/sip_common.h"
 #include "inner/sip_session.h"
 #include "request/RequestProxyImpl.h"
@@ -41,6 +42,8 @@ SuperPlatformImpl::SuperPlatformImpl(super_account account, const std::shared_pt
     , account_(std::move(account))
     , keepalive_ticker_(std::make_shared<toolkit::Ticker>()) {
     local_server_weak_ = server;
+    init_udp_peer(server);
+    bind_poller(server, account_.platform_id);
 
     const auto &server_account = server->get_account();
     if (account_.local_host.empty()) {
@@ -80,38 +83,36 @@ void SuperPlatformImpl::start() {
 
 void SuperPlatformImpl::start_l() {
 
-    const char * host = temp_host_.empty() ? account_.host.c_str() : temp_host_.c_str();
+    std::string host = temp_host_.empty() ? account_.host : temp_host_;
     uint16_t port = temp_host_.empty() ? account_.port : temp_port_ == 0 ? account_.port : temp_port_;
     DebugL << "platform " << account_.platform_id << ", address = " << host << ":" << port;
 
-    if (SockUtil::is_ipv4(host) || SockUtil::is_ipv6(host)) {
-        struct sockaddr_storage addr = SockUtil::make_sockaddr(host, port);
+    if (SockUtil::is_ipv4(host.c_str()) || SockUtil::is_ipv6(host.c_str())) {
+        struct sockaddr_storage addr = SockUtil::make_sockaddr(host.c_str(), port);
         on_platform_addr_changed(addr);
-        to_register(0);
-    } else {
-        auto poller = toolkit::EventPollerPool::Instance().getPoller();
-        std::weak_ptr<SuperPlatformImpl> this_weak = shared_from_this();
-        WorkThreadPool::Instance().getPoller()->async(
-            [poller, host = host, port = port, this_weak]() {
-                auto storage_self = this_weak.lock();
-                if (!storage_self) {
-                    return;
-                }
-                struct sockaddr_storage addr{};
-                auto ret = SockUtil::getDomainIP(host, port, addr, AF_INET, SOCK_DGRAM, IPPROTO_TCP);
-                if (ret) {
-                    storage_self->on_platform_addr_changed(addr);
-                    poller->async_first([storage_self]() { storage_self->to_register(0); });
-                    return;
-                }
-                poller->doDelayTask(3 * 1000, [this_weak]() {
-                    if (auto this_ptr = this_weak.lock()) {
-                        this_ptr->start_l();
-                    }
-                    return 0;
-                });
-            });
+        schedule_register(0, "", 0);
+        return;
     }
+    auto poller = get_poller();
+    std::weak_ptr<SuperPlatformImpl> this_weak = shared_from_this();
+    // 缓存命中时同步回调, 否则在后台线程解析后回调; 失败结果也会短暂缓存, 重试不会频繁阻塞解析线程
+    DnsCache::Instance().resolve(host, port, [poller, this_weak](bool success, const struct sockaddr_storage &addr) {
+        auto storage_self = this_weak.lock();
+        if (!storage_self) {
+            return;
+        }
+        if (success) {
+            storage_self->on_platform_addr_changed(addr);
+            storage_self->schedule_register(0, "", 0);
+            return;
+        }
+        poller->doDelayTask(3 * 1000, [this_weak]() {
+            if (auto this_ptr = this_weak.lock()) {
+                this_ptr->start_l();
+            }
+            return 0;
+        });
+    });
 }
 
 std::shared_ptr<LocalServer> SuperPlatformImpl::get_local_server() const {
@@ -127,6 +128,7 @@ struct RegisterContext {
     std::shared_ptr<SuperPlatformImpl> platform;
     int expires; // 注册有效期
     std::string authorization; // 认证信息
+    bool scheduled; // 是否占用 SipSuperScheduler 的注册名额
 };
 
 // ReSharper disable once CppDFAConstantFunctionResult
@@ -145,7 +147,10 @@ int SuperPlatformImpl::on_register_reply(
     std::string authorization_str = std::move(context->authorization);
     int expires = context->expires;
     auto platform_ptr = context->platform;
+    bool scheduled = context->scheduled;
     delete context;
+    // 注册已结束, 释放名额
+    platform_ptr->release_register(scheduled);
 
     std::weak_ptr<SuperPlatformImpl> this_weak = platform_ptr;
 
@@ -155,17 +160,12 @@ int SuperPlatformImpl::on_register_reply(
     }
 
     // 获取当前线程
-    auto poller = toolkit::EventPollerPool::Instance().getPoller();
+    auto poller = platform_ptr->get_poller();
 
-    // 延迟注册
-    auto delay_register = [poller, this_weak](int expires, std::string&& authorization_str ,int delay = 3 * 1000) {
+    // 延迟注册, 由 SipSuperScheduler 统一调度
+    auto delay_register = [&platform_ptr](int expires, std::string&& authorization_str ,int delay = 3 * 1000) {
         // 3秒后执行注册
-        return poller->doDelayTask(delay, [this_weak, expires, authorization_str = std::move(authorization_str)]() {
-            if(auto storage_self = this_weak.lock()) {
-                storage_self->to_register(expires, authorization_str);
-            }
-            return 0;
-        });
+        platform_ptr->schedule_register(expires, std::move(authorization_str), delay);
     };
 
     // 请求超时
@@ -187,9 +187,7 @@ int SuperPlatformImpl::on_register_reply(
         if (expires == 0) {
             platform_ptr->set_status(PlatformStatusType::offline, "active logout");
             if (platform_ptr->running_.load()) {
-                poller->async_first([platform_ptr]() {
-                    platform_ptr->to_register(platform_ptr->account_.register_expired);
-                });
+                platform_ptr->schedule_register(platform_ptr->account_.register_expired, "", 0);
             }
             return 0;
         }
@@ -205,15 +203,9 @@ int SuperPlatformImpl::on_register_reply(
         }
 
         // 定义刷新注册任务
-        platform_ptr->refresh_register_timer_ = delay_register(expires, std::move(authorization_str), (std::max)(expires - 5, 5) * 1000);
+        delay_register(expires, std::move(authorization_str), (std::max)(expires - 5, 5) * 1000);
         platform_ptr->keepalive_ticker_ = std::make_shared<toolkit::Ticker>();
-        platform_ptr->keepalive_timer_ = std::make_shared<Timer>(platform_ptr->account_.keepalive_interval, [this_weak]() {
-            if (auto storage_self = this_weak.lock()) {
-                storage_self->to_keepalive();
-                return true;
-            }
-            return false;
-        }, poller);
+        platform_ptr->schedule_keepalive(platform_ptr->account_.keepalive_interval * 1000ull);
         // 设置平台状态
         platform_ptr->set_status(PlatformStatusType::online, "");
         // 发送心跳
@@ -247,7 +239,7 @@ int SuperPlatformImpl::on_register_reply(
                 }
                 platform_ptr->temp_host_ = sip_host_str;
                 //
-                EventPollerPool::Instance().getExecutor()->async([this_weak]() {
+                platform_ptr->get_poller()->async([this_weak]() {
                     if (auto storage_self = this_weak.lock()) {
                         storage_self->start_l();
                     }
@@ -298,20 +290,18 @@ int SuperPlatformImpl::on_register_reply(
     return 0;
 }
 
-void SuperPlatformImpl::to_register(int expires, const std::string &authorization) {
-    if (refresh_register_timer_) {
-        refresh_register_timer_->cancel();
-        refresh_register_timer_.reset();
-    }
+bool SuperPlatformImpl::to_register(int expires, const std::string &authorization, bool scheduled) {
+    // 取消之前调度的注册
+    ++register_seq_;
     // 如果非注销，且平台已停止运行
     if (expires && !running_.load()) {
-        return;
+        return false;
     }
     std::string from = get_from_uri();
     std::string to = get_to_uri();
 
     // 记录平台
-    auto register_context = new RegisterContext { shared_from_this(), expires };
+    auto register_context = new RegisterContext { shared_from_this(), expires, "", scheduled };
     // 构建注册事务
     std::shared_ptr<sip_uac_transaction_t> reg_trans(
         sip_uac_register(
@@ -331,22 +321,56 @@ void SuperPlatformImpl::to_register(int expires, const std::string &authorizatio
     uac_send(reg_trans, {}, [register_context](bool ret, const std::string &err) {
         // 发送失败 ?
         if (!ret) {
+            register_context->platform->release_register(register_context->scheduled);
             if (register_context->platform.use_count() > 1) {
                 register_context->platform->set_status(PlatformStatusType::network_error, err);
-                std::weak_ptr<SuperPlatformImpl> weak_self = register_context->platform;
-                EventPollerPool::Instance().getPoller()->doDelayTask(
-                    3 * 1000,
-                    [weak_self, authorization = std::move(register_context->authorization),
-                     expires = register_context->expires]() {
-                        if (auto strong_self = weak_self.lock()) {
-                            strong_self->to_register(expires, authorization);
-                        }
-                        return 0;
-                    });
+                register_context->platform->schedule_register(
+                    register_context->expires, std::move(register_context->authorization), 3 * 1000);
             }
             delete register_context;
         }
     });
+    return true;
+}
+
+void SuperPlatformImpl::schedule_register(int expires, std::string authorization, uint64_t delay_ms) {
+    auto seq = ++register_seq_;
+    if (auto server = get_sip_server()) {
+        server->super_scheduler().schedule_register(
+            shared_from_this(), seq, expires, std::move(authorization), delay_ms);
+    }
+}
+
+bool SuperPlatformImpl::on_register_due(uint64_t seq, int expires, const std::string &authorization) {
+    if (seq != register_seq_.load()) {
+        return false;
+    }
+    return to_register(expires, authorization, true);
+}
+
+void SuperPlatformImpl::release_register(bool scheduled) {
+    if (!scheduled) {
+        return;
+    }
+    if (auto server = get_sip_server()) {
+        server->super_scheduler().release_register();
+    }
+}
+
+void SuperPlatformImpl::schedule_keepalive(uint64_t delay_ms) {
+    auto seq = ++keepalive_seq_;
+    if (auto server = get_sip_server()) {
+        server->super_scheduler().schedule_keepalive(shared_from_this(), seq, delay_ms);
+    }
+}
+
+bool SuperPlatformImpl::on_keepalive_due(uint64_t seq) {
+    if (seq != keepalive_seq_.load()) {
+        return false;
+    }
+    schedule_keepalive(account_.keepalive_interval * 1000ull);
+    to_keepalive();
+    return true;
 }
 
 void SuperPlatformImpl::to_keepalive() {
@@ -366,7 +390,7 @@ void SuperPlatformImpl::to_keepalive() {
                         std::dynamic_pointer_cast<SuperPlatform>(this_ptr), true, proxy->error());
                     return;
                 }
-                EventPollerPool::Instance().getPoller()->async([weak_this, proxy]() {
+                this_ptr->get_poller()->async([weak_this, proxy]() {
                     if (auto this_ptr = weak_this.lock()) {
                         NOTICE_EMIT(
                             kEventSuperPlatformKeepaliveArgs, Broadcast::kEventSuperPlatformKeepalive,
@@ -377,7 +401,7 @@ void SuperPlatformImpl::to_keepalive() {
                 if (this_ptr->keepalive_ticker_->elapsedTime()
                     >= this_ptr->account_.keepalive_interval * this_ptr->account_.keepalive_times * 1000) {
                     // 停止心跳检测
-                    this_ptr->keepalive_timer_.reset();
+                    ++this_ptr->keepalive_seq_;
                     this_ptr->set_status(
                         PlatformStatusType::offline,
                         "keepalive timeout, " + std::to_string(this_ptr->keepalive_ticker_->elapsedTime() / 1000));
@@ -509,7 +533,7 @@ public:
             }
         };
         // 设置超时任务
-        ctx->timeout = toolkit::EventPollerPool::Instance().getPoller()->doDelayTask(
+        ctx->timeout = platform->get_poller()->doDelayTask(
             GB28181_QUERY_TIMEOUT_MS, [device_id = ctx->request->device_id().value_or(""), response]() {
                 auto resp = create_response<Response>(device_id);
                 resp->reason() = "timeout";
@@ -640,7 +664,7 @@ struct MultiResponseQueryHandler<Request, Response, EventType, RET(Args...)> {
             }
         };
         // 设置超时任务
-        ctx->timeout = EventPollerPool::Instance().getPoller()->doDelayTask(
+        ctx->timeout = platform->get_poller()->doDelayTask(
             GB28181_QUERY_TIMEOUT_MS, [device_id = ctx->request->device_id().value_or(""), response]() {
                 auto resp = create_response<Response>(device_id);
                 resp->reason() = "timeout";
@@ -842,14 +866,9 @@ void SuperPlatformImpl::set_status(PlatformStatusType status, const std::string
         account_.plat_status.offline_time = toolkit::getCurrentMicrosecond(true);
     }
     account_.plat_status.status = status;
-    toolkit::EventPollerPool::Instance().getExecutor()->async(
+    get_poller()->async(
         [this_ptr = shared_from_this(), status, error]() {
-            {
-                std::lock_guard<decltype(status_cbs_mtx_)> lck( this_ptr->status_cbs_mtx_);
-                for(auto &it : this_ptr->status_cbs_) {
-                    it.second(status);
-                }
-            }
+            this_ptr->emit_platform_status(status);
             NOTICE_EMIT(
                 kEventSuperPlatformStatusArgs, Broadcast::kEventSuperPlatformStatus,
                 std::dynamic_pointer_cast<SuperPlatform>(this_ptr), status, error);
@@ -10,9 +10,6 @@
 namespace toolkit {
 class Ticker;
 }
-namespace toolkit {
-class Timer;
-}
 namespace gb28181 {
 class SipServer;
 class SuperPlatformImpl final
@@ -53,9 +50,32 @@ public:
         MessageBase &&message, std::shared_ptr<sip_uas_transaction_t> transaction,
         std::shared_ptr<sip_message_t> request) override;
 
+    /**
+     * 调度的注册到期, 由 SipSuperScheduler 在平台 poller 中调用
+     * @return 任务已被取消或平台已停止时返回 false, 未发起注册
+     */
+    bool on_register_due(uint64_t seq, int expires, const std::string &authorization);
+    /**
+     * 调度的心跳到期, 发送心跳并调度下一次心跳
+     * @return 任务已被取消时返回 false
+     */
+    bool on_keepalive_due(uint64_t seq);
+
 private:
-    void to_register(int expires, const std::string &authorization = "");
+    bool to_register(int expires, const std::string &authorization = "", bool scheduled = false);
     void to_keepalive();
+    /**
+     * 通过 SipSuperScheduler 延迟注册, 取消之前调度的注册
+     */
+    void schedule_register(int expires, std::string authorization, uint64_t delay_ms);
+    /**
+     * 通过 SipSuperScheduler 调度下一次心跳, 取消之前调度的心跳
+     */
+    void schedule_keepalive(uint64_t delay_ms);
+    /**
+     * 调度的注册结束, 释放注册名额
+     */
+    void release_register(bool scheduled);
 
     static int
     on_register_reply(void *param, const struct sip_message_t *reply, struct sip_uac_transaction_t *t, int code);
@@ -73,8 +93,8 @@ private:
     uint16_t temp_port_ {0};
     int auth_failed_count_ { 0 };
     std::pair<std::string, int> nc_pair_;
-    std::shared_ptr<toolkit::Timer> keepalive_timer_; // 心跳定时器
-    std::shared_ptr<toolkit::EventPoller::DelayTask> refresh_register_timer_;
+    std::atomic<uint64_t> register_seq_ { 0 }; // 注册序号, 递增后之前调度的注册失效
+    std::atomic<uint64_t> keepalive_seq_ { 0 }; // 心跳序号, 递增后之前调度的心跳失效
     std::vector<std::string> fault_devices_;
     std::shared_ptr<toolkit::Ticker> keepalive_ticker_;
 };
@@ -0,0 +1,155 @@
+/**
+ * 平台表并发查询基准测试
+ * 多个线程同时按编码随机查询平台(模拟各 poller 处理收到的消息), 另有一个线程持续增删平台, 对比:
+ *  global: 分片前的实现, 整张表一把读写锁
+ *  sharded: 当前实现, 按编码分 64 片, 每片一把读写锁
+ * 分片只减少读写锁本身缓存行的争用, 效果取决于核数, 需要在多核机器上运行
+ * 输出每秒查询次数与写入次数
+ *
+ * 用法: gb28181_bench_registry [-p 平台数(50000)] [-t 查询线程数(16)] [-s 每项测试秒数(3)] [-w 每秒写入次数(1000)]
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "inner/device_code.h"
+#include "inner/platform_registry.h"
+
+using namespace gb28181;
+
+struct Platform {
+    DeviceCode code;
+};
+
+// 分片前的平台表, 只保留测试用到的接口
+class GlobalRegistry {
+public:
+    using Ptr = std::shared_ptr<Platform>;
+
+    Ptr find(const DeviceCode &code) const {
+        std::shared_lock<std::shared_mutex> lck(_mtx);
+        auto it = _map.find(code);
+        return it == _map.end() ? nullptr : it->second;
+    }
+
+    Ptr assign(const DeviceCode &code, Ptr platform) {
+        std::unique_lock<std::shared_mutex> lck(_mtx);
+        _map[code].swap(platform);
+        return platform;
+    }
+
+    Ptr remove(const DeviceCode &code) {
+        std::unique_lock<std::shared_mutex> lck(_mtx);
+        auto it = _map.find(code);
+        if (it == _map.end()) {
+            return nullptr;
+        }
+        auto platform = std::move(it->second);
+        _map.erase(it);
+        return platform;
+    }
+
+private:
+    mutable std::shared_mutex _mtx;
+    std::unordered_map<DeviceCode, Ptr, DeviceCode::Hash> _map;
+};
+
+template <typename Registry>
+static void run(const char *name, const std::vector<DeviceCode> &codes, size_t threads, double seconds,
+                size_t writes_per_second) {
+    Registry registry;
+    for (auto &code : codes) {
+        registry.assign(code, std::make_shared<Platform>(Platform { code }));
+    }
+
+    std::atomic_bool running { true };
+    std::atomic<uint64_t> lookups { 0 };
+    std::atomic<uint64_t> writes { 0 };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i]() {
+            std::minstd_rand rng(static_cast<uint32_t>(i + 1));
+            uint64_t count = 0, found = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                // 每次检查停止标记前查询一批, 减少标记本身的开销
+                for (int j = 0; j < 256; ++j) {
+                    found += registry.find(codes[rng() % codes.size()]) != nullptr;
+                }
+                count += 256;
+            }
+            lookups += count;
+            if (found == 0) {
+                std::cerr << "no platform found" << std::endl;
+            }
+        });
+    }
+    // 平台反复下线再上线, 写入集中在前 1% 的平台
+    std::thread writer([&]() {
+        if (!writes_per_second) {
+            return;
+        }
+        auto interval = std::chrono::nanoseconds(1000000000ull / writes_per_second);
+        auto next = std::chrono::steady_clock::now();
+        size_t index = 0;
+        auto hot = (std::max)(codes.size() / 100, static_cast<size_t>(1));
+        while (running.load(std::memory_order_relaxed)) {
+            auto &code = codes[index++ % hot];
+            if (auto platform = registry.remove(code)) {
+                registry.assign(code, std::move(platform));
+            }
+            writes += 2;
+            next += interval;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running = false;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    writer.join();
+    std::cout << name << ": " << lookups / seconds / 1000000 << " M lookups/s (" << threads << " threads), "
+              << writes / seconds << " writes/s" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t platforms = 50000;
+    size_t threads = 16;
+    double seconds = 3;
+    size_t writes_per_second = 1000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "-p") {
+            platforms = (std::max)(std::stoul(argv[i + 1]), 1ul);
+        } else if (arg == "-t") {
+            threads = (std::max)(std::stoul(argv[i + 1]), 1ul);
+        } else if (arg == "-s") {
+            seconds = std::stod(argv[i + 1]);
+        } else if (arg == "-w") {
+            writes_per_second = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-p platforms] [-t threads] [-s seconds] [-w writes_per_second]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<DeviceCode> codes(platforms);
+    char id[32];
+    for (size_t i = 0; i < platforms; ++i) {
+        snprintf(id, sizeof(id), "3402000000118%07zu", i);
+        DeviceCode::parse(id, 20, codes[i]);
+    }
+    std::cout << "platforms " << platforms << ", cpus " << std::thread::hardware_concurrency() << std::endl;
+    run<GlobalRegistry>("global", codes, threads, seconds, writes_per_second);
+    run<PlatformRegistry<Platform>>("sharded", codes, threads, seconds, writes_per_second);
+    return 0;
+}
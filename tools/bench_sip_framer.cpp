@@ -0,0 +1,188 @@
+/**
+ * tcp 接收分帧基准测试
+ * 对比 SipFramer 与改造前的接收处理方式(每个 tcp 数据块追加到缓存末尾, 从缓存开头重新查找起始行与 Content-Length,
+ * 取出消息后从缓存头部 erase), 输入为心跳等小消息与 Catalog 等大消息混合的数据流, 按随机长度切分后逐块输入
+ *
+ * 用法: gb28181_bench_framer [-n 消息数(200000)] [-c 最大数据块长度(4096)] [-l 大消息比例, 百分比(20)]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "inner/sip_framer.h"
+
+using namespace gb28181;
+
+// 改造前的处理方式: 追加、整体重新扫描、头部删除
+class LegacyFramer {
+public:
+    // 返回本次输入后取出的完整消息数
+    size_t input(const char *data, size_t size) {
+        _buffer.append(data, size);
+        size_t count = 0;
+        while (true) {
+            std::string_view view(_buffer);
+            size_t start = std::string_view::npos;
+            size_t pos = 0;
+            // 每次都从头查找起始行
+            while (pos < view.size()) {
+                auto end = view.find('\n', pos);
+                if (end == std::string_view::npos) {
+                    break;
+                }
+                auto line = view.substr(pos, end - pos);
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                if (SipFramer::check_start_line(line.data(), line.size()) != SipFramer::MessageType::unknown) {
+                    start = pos;
+                    break;
+                }
+                pos = end + 1;
+            }
+            if (start == std::string_view::npos) {
+                return count;
+            }
+            // 查找头域结束位置与 Content-Length
+            size_t content_length = 0;
+            size_t body = std::string_view::npos;
+            pos = start;
+            while (pos < view.size()) {
+                auto end = view.find('\n', pos);
+                if (end == std::string_view::npos) {
+                    break;
+                }
+                auto line = view.substr(pos, end - pos);
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                pos = end + 1;
+                if (line.empty()) {
+                    body = pos;
+                    break;
+                }
+                size_t value_pos = 0;
+                if (SipFramer::is_header(line.data(), line.size(), "content-length", value_pos)) {
+                    content_length = std::strtoul(std::string(line.substr(value_pos)).c_str(), nullptr, 10);
+                }
+            }
+            if (body == std::string_view::npos || view.size() - body < content_length) {
+                return count;
+            }
+            _bytes += body + content_length - start;
+            _buffer.erase(0, body + content_length);
+            ++count;
+        }
+    }
+
+    size_t bytes() const { return _bytes; }
+
+private:
+    std::string _buffer;
+    size_t _bytes { 0 };
+};
+
+static std::string make_message(size_t index, bool large) {
+    std::string body;
+    if (large) {
+        body = "<?xml version=\"1.0\" encoding=\"GB2312\"?>\r\n<Response>\r\n<CmdType>Catalog</CmdType>\r\n<SN>"
+            + std::to_string(index) + "</SN>\r\n<DeviceList Num=\"40\">\r\n";
+        for (int i = 0; i < 40; ++i) {
+            body += "<Item>\r\n<DeviceID>3402000000132000" + std::to_string(1000 + i)
+                + "</DeviceID>\r\n<Name>Camera</Name>\r\n<Manufacturer>Vendor</Manufacturer>\r\n<Status>ON</Status>\r\n"
+                  "<Parental>0</Parental>\r\n<ParentID>34020000001180000001</ParentID>\r\n</Item>\r\n";
+        }
+        body += "</DeviceList>\r\n</Response>\r\n";
+    } else {
+        body = "<?xml version=\"1.0\" encoding=\"GB2312\"?>\r\n<Notify>\r\n<CmdType>Keepalive</CmdType>\r\n<SN>"
+            + std::to_string(index)
+            + "</SN>\r\n<DeviceID>34020000001180000001</DeviceID>\r\n<Status>OK</Status>\r\n</Notify>\r\n";
+    }
+    return "MESSAGE sip:34020000002000000001@3402000000 SIP/2.0\r\n"
+           "Via: SIP/2.0/TCP 192.168.1.2:5060;rport;branch=z9hG4bK"
+        + std::to_string(index)
+        + "\r\n"
+          "From: <sip:34020000001180000001@3402000000>;tag="
+        + std::to_string(index)
+        + "\r\n"
+          "To: <sip:34020000002000000001@3402000000>\r\n"
+          "Call-ID: "
+        + std::to_string(index)
+        + "@192.168.1.2\r\n"
+          "CSeq: 20 MESSAGE\r\n"
+          "Content-Type: Application/MANSCDP+xml\r\n"
+          "Max-Forwards: 70\r\n"
+          "Content-Length: "
+        + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+int main(int argc, char **argv) {
+    size_t count = 200000;
+    size_t max_chunk = 4096;
+    size_t large_percent = 20;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "-n") {
+            count = std::stoul(argv[i + 1]);
+        } else if (arg == "-c") {
+            max_chunk = (std::max)(std::stoul(argv[i + 1]), 1ul);
+        } else if (arg == "-l") {
+            large_percent = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-n message_count] [-c max_chunk] [-l large_percent]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(1);
+    std::string stream;
+    for (size_t i = 0; i < count; ++i) {
+        stream += make_message(i, rng() % 100 < large_percent);
+    }
+    // 模拟 tcp 数据块边界
+    std::vector<size_t> chunks;
+    for (size_t pos = 0; pos < stream.size();) {
+        auto size = (std::min)(static_cast<size_t>(rng() % max_chunk + 1), stream.size() - pos);
+        chunks.emplace_back(size);
+        pos += size;
+    }
+    std::cout << "messages " << count << ", bytes " << stream.size() << ", chunks " << chunks.size() << std::endl;
+
+    auto report = [&](const char *name, size_t frames, size_t bytes, std::chrono::steady_clock::duration cost) {
+        auto seconds = std::chrono::duration<double>(cost).count();
+        std::cout << name << ": " << frames << " messages, " << stream.size() / seconds / 1024 / 1024 << " MB/s, "
+                  << frames / seconds << " msg/s" << (bytes == stream.size() ? "" : ", byte count mismatch")
+                  << std::endl;
+    };
+    {
+        LegacyFramer framer;
+        size_t frames = 0, pos = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (auto size : chunks) {
+            frames += framer.input(stream.data() + pos, size);
+            pos += size;
+        }
+        report("legacy", frames, framer.bytes(), std::chrono::steady_clock::now() - begin);
+    }
+    {
+        SipFramer framer;
+        SipFramer::Frame frame;
+        size_t frames = 0, bytes = 0, pos = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (auto size : chunks) {
+            framer.input(stream.data() + pos, size);
+            pos += size;
+            while (framer.next(frame)) {
+                ++frames;
+                bytes += frame.size;
+            }
+        }
+        report("framer", frames, bytes, std::chrono::steady_clock::now() - begin);
+    }
+    return 0;
+}
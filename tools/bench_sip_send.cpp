@@ -0,0 +1,166 @@
+/**
+ * sip 应答发送路径基准测试
+ * 在 poller 线程内(libsip 回调中的常见情况)成批发送 200 OK 应答, 通过回环地址发往另一个 poller 上的接收 socket, 对比:
+ *  legacy: 改造前的实现, 每条消息新建 BufferRaw 拷贝负载, 再投递异步任务到所属 poller 发送
+ *  session: 当前实现, 经 libsip 的发送回调 SipSession::sip_send 进入 send_buffer, 负载拷贝到对象池中的缓存,
+ *           由 SipEgress 在本轮事件循环结束时统一刷新
+ * 输出每条消息在 poller 线程上的耗时, 以及从调用发送到对端收到的时延分布
+ *
+ * 用法: gb28181_bench_send [-n 消息数(200000)] [-b 每批消息数(32)]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Network/Socket.h>
+#include <Poller/EventPoller.h>
+#include <Util/logger.h>
+
+#include "inner/sip_session.h"
+
+using namespace gb28181;
+using namespace toolkit;
+
+static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 改造前 SipSession::sip_send 的实现
+static void legacy_send(const std::shared_ptr<SipSession> &session, const char *data, size_t size) {
+    auto buffer = BufferRaw::create();
+    buffer->assign(data, size);
+    auto sock = session->getSock();
+    sock->getPoller()->async([sock, buffer = std::move(buffer)]() { sock->send(buffer); });
+}
+
+// 当前实现, 与 libsip 调用的发送回调相同
+static void session_send(const std::shared_ptr<SipSession> &session, const char *data, size_t size) {
+    SipSession::sip_send(session.get(), data, size);
+}
+
+struct Backend {
+    const char *name;
+    void (*send)(const std::shared_ptr<SipSession> &session, const char *data, size_t size);
+};
+
+static const Backend kBackends[] = {
+    { "legacy", legacy_send },
+    { "session", session_send },
+};
+
+// 序号写在 Call-ID 中, 固定 10 位
+static constexpr char kReply[] = "SIP/2.0 200 OK\r\n"
+                                 "Via: SIP/2.0/UDP 127.0.0.1:5060;rport=5060;branch=z9hG4bK1850412432\r\n"
+                                 "From: <sip:34020000001180000001@3402000000>;tag=1726461890\r\n"
+                                 "To: <sip:34020000001180000001@3402000000>;tag=1583712042\r\n"
+                                 "Call-ID: %010zu\r\n"
+                                 "CSeq: 1 REGISTER\r\n"
+                                 "User-Agent: gb28181\r\n"
+                                 "Date: 2026-10-17T12:00:00.000\r\n"
+                                 "Expires: 3600\r\n"
+                                 "Content-Length: 0\r\n\r\n";
+
+static void run(const Backend &backend, const EventPoller::Ptr &send_poller, const EventPoller::Ptr &recv_poller,
+                size_t count, size_t batch) {
+    std::vector<std::atomic<uint64_t>> send_us(count);
+    std::vector<int64_t> latency_us(count, -1);
+    std::atomic<size_t> received { 0 };
+
+    auto receiver = Socket::createSocket(recv_poller, true);
+    receiver->bindUdpSock(0, "127.0.0.1");
+    receiver->setOnRead([&](const Buffer::Ptr &buf, struct sockaddr *, int) {
+        auto now = now_us();
+        auto pos = std::string(buf->data(), buf->size()).find("Call-ID: ");
+        if (pos == std::string::npos) {
+            return;
+        }
+        auto seq = std::strtoul(buf->data() + pos + 9, nullptr, 10);
+        if (seq < count) {
+            latency_us[seq] = static_cast<int64_t>(now - send_us[seq].load(std::memory_order_relaxed));
+            received.fetch_add(1, std::memory_order_release);
+        }
+    });
+    auto receiver_addr = SockUtil::make_sockaddr("127.0.0.1", receiver->get_local_port());
+    auto sender = Socket::createSocket(send_poller, true);
+    sender->bindUdpSock(0, "127.0.0.1");
+    sender->bindPeerAddr((struct sockaddr *)&receiver_addr, 0, true);
+    auto session = std::make_shared<SipSession>(sender, false);
+
+    char reply[sizeof(kReply) + 16];
+    uint64_t poller_ns = 0;
+    for (size_t sent = 0; sent < count;) {
+        auto end = (std::min)(sent + batch, count);
+        send_poller->sync([&]() {
+            auto begin = std::chrono::steady_clock::now();
+            for (auto seq = sent; seq < end; ++seq) {
+                auto size = snprintf(reply, sizeof(reply), kReply, seq);
+                send_us[seq].store(now_us(), std::memory_order_relaxed);
+                backend.send(session, reply, static_cast<size_t>(size));
+            }
+            poller_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin)
+                             .count();
+        });
+        sent = end;
+        // 等待对端收完本批再发送下一批, 避免回环 udp 缓冲区溢出丢包
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        while (received.load(std::memory_order_acquire) < sent && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    // 在接收线程上关闭, 之后不再访问统计数据
+    recv_poller->sync([&]() { receiver->setOnRead(nullptr); });
+
+    std::vector<int64_t> latency;
+    for (auto value : latency_us) {
+        if (value >= 0) {
+            latency.emplace_back(value);
+        }
+    }
+    std::sort(latency.begin(), latency.end());
+    auto percentile = [&](double p) -> int64_t {
+        return latency.empty() ? 0 : latency[std::min(latency.size() - 1, static_cast<size_t>(p * latency.size()))];
+    };
+    std::cout << backend.name << ": poller thread " << static_cast<double>(poller_ns) / count << " ns/msg, latency p50 "
+              << percentile(0.5) << " us, p99 " << percentile(0.99) << " us, max "
+              << (latency.empty() ? 0 : latency.back()) << " us, lost " << count - latency.size() << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t count = 200000;
+    size_t batch = 32;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "-n") {
+            count = std::stoul(argv[i + 1]);
+        } else if (arg == "-b") {
+            batch = (std::max)(std::stoul(argv[i + 1]), 1ul);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-n message_count] [-b batch]" << std::endl;
+            return 1;
+        }
+    }
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LogLevel::LWarn));
+
+    // 发送与接收使用不同的 poller, 只有一个 poller 时共用
+    std::vector<EventPoller::Ptr> pollers;
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+        pollers.emplace_back(std::static_pointer_cast<EventPoller>(executor));
+    });
+    auto send_poller = pollers.front();
+    auto recv_poller = pollers.size() > 1 ? pollers[1] : pollers.front();
+    for (auto &backend : kBackends) {
+        run(backend, send_poller, recv_poller, count, batch);
+    }
+    return 0;
+}
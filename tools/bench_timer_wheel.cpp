@@ -0,0 +1,174 @@
+/**
+ * libsip 事务定时器基准测试
+ * 对比 SipTimerWheel 与改造前的实现(每个定时器 new 上下文并 doDelayTask 到任意 poller, 停止时投递异步任务取消并释放):
+ *  1. poller 线程内启动并停止(libsip 回调中的常见情况), 保持 1024 个未到期的定时器
+ *  2. 非 poller 线程启动并停止(业务线程直接发送请求)
+ *  3. 定时器触发时间晚于超时时间的延迟分布
+ *
+ * 用法: gb28181_bench_timer [-n 启动停止次数(1000000)] [-f 触发测试的定时器数(100000)]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Poller/EventPoller.h>
+#include <Util/logger.h>
+
+#include "inner/sip_timer_wheel.h"
+
+using namespace gb28181;
+using namespace toolkit;
+
+using Handler = void (*)(void *param);
+
+// 改造前 timer_impl.cpp 的实现
+struct LegacyTimer {
+    std::weak_ptr<EventPoller::DelayTask> task;
+    std::shared_ptr<EventPoller> poller;
+    std::atomic_bool handle_flag { false };
+};
+
+static void *legacy_start(int timeout, Handler handler, void *param) {
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto context = new LegacyTimer();
+    context->poller = poller;
+    context->task = poller->doDelayTask(timeout, [handler, param, context]() {
+        bool expected = false;
+        if (context->handle_flag.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            handler(param);
+        }
+        return 0;
+    });
+    return context;
+}
+
+static int legacy_stop(void *id) {
+    auto context = static_cast<LegacyTimer *>(id);
+    bool expected = false;
+    bool flag = context->handle_flag.compare_exchange_strong(expected, true, std::memory_order_acq_rel);
+    context->poller->async([context]() {
+        if (auto task = context->task.lock()) {
+            task->cancel();
+        }
+        delete context;
+    });
+    return flag ? 0 : -1;
+}
+
+struct Backend {
+    const char *name;
+    void *(*start)(int timeout, Handler handler, void *param);
+    int (*stop)(void *id);
+};
+
+static const Backend kBackends[] = {
+    { "legacy", legacy_start, legacy_stop },
+    { "wheel", SipTimerWheel::start, SipTimerWheel::stop },
+};
+
+static uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 启动并停止 count 次, 环形保持 1024 个未到期的定时器, 返回每次启动+停止的耗时(纳秒)
+static double start_stop(const Backend &backend, size_t count) {
+    std::vector<void *> ids(1024, nullptr);
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        auto &id = ids[i & 1023];
+        if (id) {
+            backend.stop(id);
+        }
+        id = backend.start(500 + static_cast<int>(i % 31000), [](void *) {}, nullptr);
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+    for (auto id : ids) {
+        if (id) {
+            backend.stop(id);
+        }
+    }
+    return ns / count;
+}
+
+struct FireRecord {
+    uint64_t deadline_us { 0 };
+    std::atomic<int64_t> late_us { -1 };
+};
+
+// 启动 count 个 0~2 秒随机超时的定时器, 统计触发延迟
+static void fire_latency(const Backend &backend, size_t count) {
+    std::vector<FireRecord> records(count);
+    std::mt19937 rng(1);
+    auto poller = EventPollerPool::Instance().getPoller();
+    poller->sync([&]() {
+        for (auto &record : records) {
+            auto timeout = static_cast<int>(rng() % 2000);
+            record.deadline_us = now_us() + timeout * 1000ull;
+            backend.start(
+                timeout,
+                [](void *param) {
+                    auto record = static_cast<FireRecord *>(param);
+                    record->late_us = static_cast<int64_t>(now_us()) - static_cast<int64_t>(record->deadline_us);
+                },
+                &record);
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    std::vector<int64_t> late;
+    size_t early = 0, lost = 0;
+    for (auto &record : records) {
+        auto value = record.late_us.load();
+        if (value == -1) {
+            ++lost;
+        } else {
+            early += value < 0;
+            late.emplace_back(value);
+        }
+    }
+    std::sort(late.begin(), late.end());
+    auto percentile = [&](double p) -> int64_t {
+        return late.empty() ? 0 : late[std::min(late.size() - 1, static_cast<size_t>(p * late.size()))];
+    };
+    std::cout << backend.name << " fire latency: p50 " << percentile(0.5) << " us, p99 " << percentile(0.99)
+              << " us, max " << (late.empty() ? 0 : late.back()) << " us, early " << early << ", lost " << lost
+              << std::endl;
+}
+
+int main(int argc, char **argv) {
+    size_t count = 1000000;
+    size_t fire_count = 100000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "-n") {
+            count = std::stoul(argv[i + 1]);
+        } else if (arg == "-f") {
+            fire_count = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-n start_stop_count] [-f fire_count]" << std::endl;
+            return 1;
+        }
+    }
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LogLevel::LWarn));
+
+    auto poller = EventPollerPool::Instance().getPoller();
+    for (auto &backend : kBackends) {
+        double on_poller = 0;
+        poller->sync([&]() { on_poller = start_stop(backend, count); });
+        auto off_poller = start_stop(backend, count);
+        std::cout << backend.name << " start+stop: poller thread " << on_poller << " ns/op, other thread "
+                  << off_poller << " ns/op" << std::endl;
+        // 等待取消任务与回收执行完毕
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    for (auto &backend : kBackends) {
+        fire_latency(backend, fire_count);
+    }
+    return 0;
+}
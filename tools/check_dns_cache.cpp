@@ -0,0 +1,180 @@
+/**
+ * 域名解析缓存检查
+ * 通过 set_resolver 替换为本地桩解析器, 按较短的 ttl 检查 DnsCache 的缓存行为:
+ *  1. 成功结果在 ttl 内命中缓存, 不再调用解析器, 回调地址带有请求的端口
+ *  2. 成功结果在使用超过 80% 的 ttl 后由后台定时器刷新, 不依赖再次调用 resolve
+ *  3. 失败结果按失败 ttl 缓存, 过期后再次解析
+ *  4. 刷新失败时继续使用旧地址
+ *  5. 相同域名同时只解析一次, 等待中的请求全部收到结果
+ * 任意一项不通过时返回非 0, 运行约 15 秒
+ *
+ * 用法: gb28181_check_dns
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Network/sockutil.h>
+#include <Util/logger.h>
+
+#include "inner/dns_cache.h"
+
+using namespace gb28181;
+using namespace toolkit;
+
+// 桩解析器, 每个域名按调用次数依次返回预设结果, 超出后重复最后一个
+class StubResolver {
+public:
+    // 空字符串表示解析失败
+    void set(const std::string &host, std::vector<std::string> results) {
+        std::lock_guard<std::mutex> lck(_mtx);
+        _results[host] = std::move(results);
+        _calls[host] = 0;
+    }
+
+    void set_delay(int delay_ms) { _delay_ms = delay_ms; }
+
+    size_t calls(const std::string &host) {
+        std::lock_guard<std::mutex> lck(_mtx);
+        return _calls[host];
+    }
+
+    bool operator()(const std::string &host, struct sockaddr_storage &addr) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(_delay_ms.load()));
+        std::string ip;
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            auto &results = _results[host];
+            auto index = _calls[host]++;
+            if (results.empty()) {
+                return false;
+            }
+            ip = results[(std::min)(index, results.size() - 1)];
+        }
+        if (ip.empty()) {
+            return false;
+        }
+        addr = SockUtil::make_sockaddr(ip.data(), 0);
+        return true;
+    }
+
+private:
+    std::mutex _mtx;
+    std::unordered_map<std::string, std::vector<std::string>> _results;
+    std::unordered_map<std::string, size_t> _calls;
+    std::atomic<int> _delay_ms { 0 };
+};
+
+struct Result {
+    bool done { false };
+    bool success { false };
+    bool sync { false }; // 在调用线程直接回调
+    std::string ip;
+    uint16_t port { 0 };
+};
+
+// 发起解析并等待回调, 超时未回调时 done 为 false
+static Result resolve(const std::string &host, uint16_t port) {
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto future = promise->get_future();
+    auto caller = std::this_thread::get_id();
+    DnsCache::Instance().resolve(host, port, [promise, caller](bool success, const struct sockaddr_storage &addr) {
+        Result result;
+        result.done = true;
+        result.success = success;
+        result.sync = std::this_thread::get_id() == caller;
+        if (success) {
+            result.ip = SockUtil::inet_ntoa((const struct sockaddr *)&addr);
+            result.port = SockUtil::inet_port((const struct sockaddr *)&addr);
+        }
+        promise->set_value(std::move(result));
+    });
+    if (future.wait_for(std::chrono::seconds(3)) != std::future_status::ready) {
+        return {};
+    }
+    return future.get();
+}
+
+static int failed = 0;
+
+static void check(bool ok, const std::string &what) {
+    std::cout << (ok ? "[ OK ] " : "[FAIL] ") << what << std::endl;
+    failed += !ok;
+}
+
+int main() {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LogLevel::LError));
+
+    auto stub = std::make_shared<StubResolver>();
+    auto &cache = DnsCache::Instance();
+    cache.set_resolver([stub](const std::string &host, struct sockaddr_storage &addr) { return (*stub)(host, addr); });
+    // 成功缓存 6 秒, 4.8 秒后刷新, 留出大于定时器间隔(1 秒)的刷新窗口; 失败缓存 1 秒
+    cache.set_ttl(6, 1);
+
+    {
+        stub->set("cached.test", { "10.0.0.1", "10.0.0.2" });
+        auto first = resolve("cached.test", 5060);
+        check(first.done && first.success && first.ip == "10.0.0.1" && first.port == 5060 && !first.sync,
+              "first lookup resolves in background");
+        auto second = resolve("cached.test", 5061);
+        check(second.success && second.ip == "10.0.0.1" && second.port == 5061 && second.sync
+                  && stub->calls("cached.test") == 1,
+              "lookup within ttl hits cache");
+        // 期间不调用 resolve, 由定时器在过期前刷新
+        std::this_thread::sleep_for(std::chrono::milliseconds(5900));
+        check(stub->calls("cached.test") == 2, "timer refreshes entry before expiry");
+        auto third = resolve("cached.test", 5060);
+        check(third.success && third.ip == "10.0.0.2" && third.sync, "refreshed address served from cache");
+    }
+    {
+        stub->set("missing.test", { "" });
+        auto first = resolve("missing.test", 5060);
+        check(first.done && !first.success, "failed lookup reports failure");
+        auto second = resolve("missing.test", 5060);
+        check(!second.success && second.sync && stub->calls("missing.test") == 1,
+              "failure cached within negative ttl");
+        // 定时器不重试失败结果
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+        check(stub->calls("missing.test") == 1, "timer does not retry failures");
+        auto third = resolve("missing.test", 5060);
+        check(!third.success && !third.sync && stub->calls("missing.test") == 2,
+              "failure retried after negative ttl");
+    }
+    {
+        stub->set("flaky.test", { "10.0.0.3", "" });
+        auto first = resolve("flaky.test", 5060);
+        check(first.success && first.ip == "10.0.0.3", "flaky host first lookup");
+        // 刷新失败后按失败 ttl 延长旧地址的有效期
+        std::this_thread::sleep_for(std::chrono::milliseconds(6500));
+        auto second = resolve("flaky.test", 5060);
+        check(stub->calls("flaky.test") >= 2 && second.success && second.ip == "10.0.0.3",
+              "stale address kept when refresh fails");
+    }
+    {
+        stub->set("slow.test", { "10.0.0.4" });
+        stub->set_delay(200);
+        std::vector<std::future<Result>> results;
+        for (int i = 0; i < 10; ++i) {
+            results.emplace_back(std::async(std::launch::async, [i]() {
+                return resolve("slow.test", static_cast<uint16_t>(6000 + i));
+            }));
+        }
+        bool all = true;
+        for (int i = 0; i < 10; ++i) {
+            auto result = results[i].get();
+            all = all && result.success && result.ip == "10.0.0.4" && result.port == 6000 + i;
+        }
+        check(all && stub->calls("slow.test") == 1, "concurrent lookups share one resolution");
+        stub->set_delay(0);
+    }
+
+    std::cout << (failed ? "FAILED: " + std::to_string(failed) : std::string("PASSED")) << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,390 @@
+/**
+ * sip 报文回放工具
+ * 读取抓包文件(pcap 或长度前缀格式), 通过回环地址将报文发送给本地启动的 LocalServer,
+ * 统计吞吐、请求到首个应答的处理时延以及进程内存峰值, 用于升级前的压测与回归
+ *
+ * 用法: gb28181_sip_replay -f <file> [-p 抓包中服务端端口] [-l 本地监听端口] [-i 平台编码] [-d 平台域] [--fast]
+ *                          [-n 预先添加的下级平台数]
+ *  -n: 回放前通过 add_subordinate_platforms 批量添加平台并输出耗时, 不指定 -f 时只测量批量添加
+ *  pcap: 支持 Ethernet / Linux SLL / SLL2 / RAW / NULL 链路类型, 只回放发往服务端端口的 udp 报文
+ *  长度前缀格式: 每条报文为 4 字节大端长度 + 报文内容, 无时间戳, 总是以最快速度回放
+ */
+#include "gb28181/local_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Network/Socket.h>
+#include <Poller/EventPoller.h>
+#include <Util/logger.h>
+#include <sys/resource.h>
+
+using namespace gb28181;
+using namespace toolkit;
+
+struct ReplayMessage {
+    uint64_t time_us { 0 }; // 抓包时间
+    std::string source; // 源地址, 每个源地址使用独立的 socket 模拟一个设备
+    std::string data;
+};
+
+static uint32_t read_u32(const uint8_t *data, bool swap) {
+    uint32_t value;
+    memcpy(&value, data, 4);
+    return swap ? __builtin_bswap32(value) : value;
+}
+
+// 解析 ip/udp 报文, 提取发往 server_port 的 udp 负载
+static bool parse_ip_packet(const uint8_t *data, size_t size, uint16_t server_port, ReplayMessage &message) {
+    if (size < 1) {
+        return false;
+    }
+    size_t ip_size = 0;
+    uint8_t protocol = 0;
+    char source[64] {};
+    auto version = data[0] >> 4;
+    if (version == 4 && size >= 20) {
+        ip_size = (data[0] & 0x0F) * 4;
+        protocol = data[9];
+        inet_ntop(AF_INET, data + 12, source, sizeof(source));
+    } else if (version == 6 && size >= 40) {
+        ip_size = 40;
+        protocol = data[6];
+        source[0] = '[';
+        inet_ntop(AF_INET6, data + 8, source + 1, sizeof(source) - 2);
+        strcat(source, "]");
+    } else {
+        return false;
+    }
+    // 只处理 udp, tcp 报文需要重组, 不在回放范围内
+    if (protocol != IPPROTO_UDP || size < ip_size + 8) {
+        return false;
+    }
+    auto udp = data + ip_size;
+    auto src_port = (udp[0] << 8) | udp[1];
+    auto dst_port = (udp[2] << 8) | udp[3];
+    if (dst_port != server_port) {
+        return false;
+    }
+    message.source = std::string(source) + ":" + std::to_string(src_port);
+    message.data.assign((const char *)udp + 8, size - ip_size - 8);
+    return true;
+}
+
+static bool load_pcap(const std::string &data, uint16_t server_port, std::vector<ReplayMessage> &messages) {
+    auto ptr = (const uint8_t *)data.data();
+    uint32_t magic;
+    memcpy(&magic, ptr, 4);
+    bool swap = false, nano = false;
+    switch (magic) {
+        case 0xa1b2c3d4: break;
+        case 0xd4c3b2a1: swap = true; break;
+        case 0xa1b23c4d: nano = true; break;
+        case 0x4d3cb2a1: swap = nano = true; break;
+        default: return false;
+    }
+    auto link_type = read_u32(ptr + 20, swap);
+    size_t pos = 24;
+    while (pos + 16 <= data.size()) {
+        auto ts_sec = read_u32(ptr + pos, swap);
+        auto ts_frac = read_u32(ptr + pos + 4, swap);
+        auto incl_len = read_u32(ptr + pos + 8, swap);
+        pos += 16;
+        if (pos + incl_len > data.size()) {
+            break;
+        }
+        auto packet = ptr + pos;
+        size_t size = incl_len;
+        pos += incl_len;
+        size_t skip = 0;
+        switch (link_type) {
+            case 0: skip = 4; break; // NULL/Loopback
+            case 1: { // Ethernet
+                skip = 14;
+                if (size >= 18 && packet[12] == 0x81 && packet[13] == 0x00) {
+                    skip = 18;
+                }
+                break;
+            }
+            case 101: skip = 0; break; // RAW
+            case 113: skip = 16; break; // Linux SLL
+            case 276: skip = 20; break; // Linux SLL2
+            default: std::cerr << "unsupported link type " << link_type << std::endl; return false;
+        }
+        if (size <= skip) {
+            continue;
+        }
+        ReplayMessage message;
+        if (parse_ip_packet(packet + skip, size - skip, server_port, message)) {
+            message.time_us = ts_sec * 1000000ULL + (nano ? ts_frac / 1000 : ts_frac);
+            messages.emplace_back(std::move(message));
+        }
+    }
+    return true;
+}
+
+static void load_length_prefixed(const std::string &data, std::vector<ReplayMessage> &messages) {
+    size_t pos = 0;
+    while (pos + 4 <= data.size()) {
+        auto size = ntohl(read_u32((const uint8_t *)data.data() + pos, false));
+        pos += 4;
+        if (pos + size > data.size()) {
+            break;
+        }
+        ReplayMessage message;
+        message.source = "default";
+        message.data = data.substr(pos, size);
+        messages.emplace_back(std::move(message));
+        pos += size;
+    }
+}
+
+// 获取头域值, 兼容紧凑格式
+static std::string get_header(const std::string &message, const char *name, const char *compact) {
+    size_t pos = 0;
+    while (pos < message.size()) {
+        auto end = message.find('\n', pos);
+        if (end == std::string::npos) {
+            end = message.size();
+        }
+        auto line = std::string_view(message).substr(pos, end - pos);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            break;
+        }
+        auto colon = line.find(':');
+        if (colon != std::string_view::npos) {
+            auto key = line.substr(0, colon);
+            while (!key.empty() && key.back() == ' ') {
+                key.remove_suffix(1);
+            }
+            if ((strlen(name) == key.size() && strncasecmp(key.data(), name, key.size()) == 0)
+                || (strlen(compact) == key.size() && strncasecmp(key.data(), compact, key.size()) == 0)) {
+                auto value = line.substr(colon + 1);
+                while (!value.empty() && value.front() == ' ') {
+                    value.remove_prefix(1);
+                }
+                return std::string(value);
+            }
+        }
+        pos = end + 1;
+    }
+    return "";
+}
+
+// 以 Call-ID + CSeq 关联请求与应答
+static std::string transaction_key(const std::string &message) {
+    return get_header(message, "Call-ID", "i") + "|" + get_header(message, "CSeq", "CSeq");
+}
+
+class ReplayStatistics {
+public:
+    void on_send(const std::string &key) {
+        std::lock_guard<std::mutex> lck(_mtx);
+        _pending.emplace(key, std::chrono::steady_clock::now());
+    }
+    void on_reply(const std::string &key) {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lck(_mtx);
+        auto it = _pending.find(key);
+        if (it == _pending.end()) {
+            return;
+        }
+        _latency_us.emplace_back(std::chrono::duration_cast<std::chrono::microseconds>(now - it->second).count());
+        _pending.erase(it);
+    }
+    void report(size_t sent, double seconds) {
+        std::lock_guard<std::mutex> lck(_mtx);
+        std::sort(_latency_us.begin(), _latency_us.end());
+        auto percentile = [&](double p) -> uint64_t {
+            if (_latency_us.empty()) {
+                return 0;
+            }
+            return _latency_us[std::min(_latency_us.size() - 1, static_cast<size_t>(p * _latency_us.size()))];
+        };
+        struct rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        std::cout << "messages sent:      " << sent << std::endl
+                  << "replies matched:    " << _latency_us.size() << std::endl
+                  << "unanswered:         " << _pending.size() << std::endl
+                  << "duration:           " << seconds << " s" << std::endl
+                  << "messages/sec:       " << (seconds > 0 ? sent / seconds : 0) << std::endl
+                  << "latency p50:        " << percentile(0.50) << " us" << std::endl
+                  << "latency p99:        " << percentile(0.99) << " us" << std::endl
+                  << "memory high-water:  " << usage.ru_maxrss << " KB" << std::endl;
+    }
+
+private:
+    std::mutex _mtx;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> _pending;
+    std::vector<uint64_t> _latency_us;
+};
+
+// 在启动线程批量添加平台并统计耗时, 平台编码为 中心编码 + 行业 + 类型(118) + 7 位序号
+static void provision(const std::shared_ptr<LocalServer> &server, const local_account &local, size_t count) {
+    std::vector<subordinate_account> accounts(count);
+    char id[32];
+    for (size_t i = 0; i < count; ++i) {
+        auto &account = accounts[i];
+        snprintf(id, sizeof(id), "%.10s118%07zu", local.domain.c_str(), i % 10000000);
+        account.platform_id = id;
+        account.domain = local.domain;
+        account.name = "provision";
+        account.host = "127.0.0.1";
+        account.port = static_cast<uint16_t>(20000 + i % 40000);
+    }
+    auto begin = std::chrono::steady_clock::now();
+    auto platforms = server->add_subordinate_platforms(std::move(accounts));
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    auto added = std::count_if(platforms.begin(), platforms.end(), [](const std::shared_ptr<SubordinatePlatform> &p) {
+        return p != nullptr;
+    });
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << "provisioned:        " << added << "/" << count << " platforms" << std::endl
+              << "provision time:     " << ms << " ms" << std::endl
+              << "memory high-water:  " << usage.ru_maxrss << " KB" << std::endl;
+}
+
+static void usage(const char *name) {
+    std::cerr << "usage: " << name
+              << " -f <file> [-p recorded_server_port(5060)] [-l listen_port(15060)] [-i platform_id] [-d domain] "
+                 "[--fast] [-n provision_count]"
+              << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::string file;
+    uint16_t server_port = 5060;
+    uint16_t listen_port = 15060;
+    bool fast = false;
+    size_t provision_count = 0;
+    local_account account;
+    account.platform_id = "65010100002000100001";
+    account.domain = "6501010000";
+    account.name = "replay";
+    account.host = "127.0.0.1";
+    account.local_host = "127.0.0.1";
+    account.auth_type = SipAuthType::none;
+    account.allow_auto_register = true;
+    account.transport_type = TransportType::udp;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto has_value = i + 1 < argc;
+        if (arg == "-f" && has_value) {
+            file = argv[++i];
+        } else if (arg == "-p" && has_value) {
+            server_port = static_cast<uint16_t>(std::stoi(argv[++i]));
+        } else if (arg == "-l" && has_value) {
+            listen_port = static_cast<uint16_t>(std::stoi(argv[++i]));
+        } else if (arg == "-i" && has_value) {
+            account.platform_id = argv[++i];
+        } else if (arg == "-d" && has_value) {
+            account.domain = argv[++i];
+        } else if (arg == "-n" && has_value) {
+            provision_count = std::stoul(argv[++i]);
+        } else if (arg == "--fast") {
+            fast = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (file.empty() && !provision_count) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::vector<ReplayMessage> messages;
+    if (!file.empty()) {
+        std::ifstream ifs(file, std::ios::binary);
+        if (!ifs) {
+            std::cerr << "open " << file << " failed" << std::endl;
+            return 1;
+        }
+        std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        if (content.size() < 24 || !load_pcap(content, server_port, messages)) {
+            load_length_prefixed(content, messages);
+            fast = true;
+        }
+        if (messages.empty()) {
+            std::cerr << "no message found in " << file << std::endl;
+            return 1;
+        }
+        std::cout << "loaded " << messages.size() << " messages" << std::endl;
+    }
+
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LogLevel::LWarn));
+
+    account.port = listen_port;
+    account.local_port = listen_port;
+    auto server = LocalServer::new_local_server(account);
+    server->set_new_subordinate_account_callback(
+        [](const std::shared_ptr<LocalServer> &, const std::shared_ptr<subordinate_account> &,
+           const std::function<void(bool)> &allow_cb) { allow_cb(true); });
+    server->run();
+
+    if (provision_count) {
+        provision(server, account, provision_count);
+    }
+    if (messages.empty()) {
+        server->shutdown();
+        return 0;
+    }
+
+    ReplayStatistics statistics;
+    auto server_addr = SockUtil::make_sockaddr("127.0.0.1", listen_port);
+    // 源地址 -> 模拟设备的 socket
+    std::unordered_map<std::string, Socket::Ptr> clients;
+    auto get_client = [&](const std::string &source) {
+        auto &sock = clients[source];
+        if (!sock) {
+            sock = Socket::createSocket(EventPollerPool::Instance().getPoller(), true);
+            sock->bindUdpSock(0, "127.0.0.1");
+            sock->bindPeerAddr((struct sockaddr *)&server_addr, 0, true);
+            sock->setOnRead([&statistics](const Buffer::Ptr &buf, struct sockaddr *, int) {
+                std::string message(buf->data(), buf->size());
+                // 只统计应答, 服务端主动发起的请求忽略
+                if (message.compare(0, 7, "SIP/2.0") == 0) {
+                    statistics.on_reply(transaction_key(message));
+                }
+            });
+        }
+        return sock;
+    };
+    for (auto &message : messages) {
+        get_client(message.source);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    auto first_time = messages.front().time_us;
+    for (auto &message : messages) {
+        if (!fast && message.time_us > first_time) {
+            std::this_thread::sleep_until(begin + std::chrono::microseconds(message.time_us - first_time));
+        }
+        if (message.data.compare(0, 7, "SIP/2.0") != 0) {
+            statistics.on_send(transaction_key(message.data));
+        }
+        auto buffer = BufferRaw::create();
+        buffer->assign(message.data.data(), message.data.size());
+        clients[message.source]->send(std::move(buffer));
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    // 等待剩余应答
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    statistics.report(messages.size(), seconds);
+
+    clients.clear();
+    server->shutdown();
+    return 0;
+}